@@ -1,18 +1,36 @@
 //---------------------------------------------------------------------------------------------------------------------
-// Evolving Spelling Puzzle. The program gets 1-2 command line arguments.
-// First one is the solution second (optional) color.
+// Evolving Spelling Puzzle. The program gets 1-6 command line arguments.
+// First one is the solution second (optional) color, --dict <file> (optional) a word list the guesses must be in,
+// --patterns <file> (optional) the table of feedback patterns of the word list used by the hint command.
 // The player tries to guess the word maximum 6 times, on each attempt he is shown the correctness of his guess
+// With --batch <file or -> [--threads x] no game is played, every line of guess and solution gets its feedback
+// pattern printed instead, scored on multiple threads.
 //---------------------------------------------------------------------------------------------------------------------
-
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <time.h>
 #define GUESS_INPUT_SIZE 1024
 #define ATTEMPTS 6
 #define WORD_LENGTH 5
 #define ANSI_COLOR_RESET "\x1b[0m"
 #define ANSI_COLOR_BLUE "\x1b[94m"
 #define ANSI_COLOR_MAGENTA "\x1b[35m"
+#define LETTER_BITS 5
+#define PATTERN_COUNT 243
+#define PATTERN_MAGIC "ESPT"
+#define PATTERN_HEADER 16
+#define MAX_PATTERN_WORDS 20000
+#define MAX_BATCH_THREADS 1024
 
 enum _ReturnCode_
 {
@@ -21,9 +39,44 @@ enum _ReturnCode_
   WIN = 1,
   LOSE = 2,
   INPUT_ERROR = 3,
-  ALRIGHT = 4
+  ALRIGHT = 4,
+  INVALID_DICTIONARY = 5,
+  HINT = 6,
+  INVALID_BATCH = 7
 } ReturnCode;
 
+// five-letter words of the word list, each packed into 25 bits (5 bits per letter, first letter highest),
+// sorted so that the order of the codes is the alphabetical order of the words
+typedef struct _Dictionary_
+{
+  uint32_t *words_;
+  int count_;
+} Dictionary;
+
+// Mapped file with the feedback pattern of every guess against every answer of a dictionary, one byte per pair
+// (a base 3 number with one digit per letter, first letter highest: 0 absent, 1 elsewhere, 2 correct). The header
+// holds the magic number, the number of words, the checksum of the dictionary and the best first guess.
+typedef struct _PatternTable_
+{
+  uint8_t *file_;
+  size_t size_;
+  int count_;
+  int opening_;
+} Pattern_table;
+
+// part of a batch scored by one thread, the lines from begin_ to end_ get one pattern each in output_
+typedef struct _BatchChunk_
+{
+  pthread_t thread_;
+  bool started_;
+  const char *begin_;
+  const char *end_;
+  char *output_;
+  size_t length_;
+  long pairs_;
+  long errors_;
+} Batch_chunk;
+
 //---------------------------------------------------------------------------------------------------------------------
 /// returns the length of the string
 ///
@@ -50,8 +103,184 @@ bool checkColorMode(const char *color_mode);
 ///
 /// @param arg array of string arguments
 /// @param count number of arguments
+/// @param color_mode color mode to set
+/// @param dictionary_path path of the word list to set, stays NULL without --dict
+/// @param patterns_path path of the pattern table to set, stays NULL without --patterns
 /// @return true if it's okay, false if not
-bool checkCommandLine(char **arg, int count);
+bool checkCommandLine(char **arg, int count, int *color_mode, const char **dictionary_path,
+                      const char **patterns_path);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// packs a word of five upper case letters into 25 bits
+///
+/// @param word word
+/// @return code of the word
+uint32_t packWord(const char *word);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// compares two word codes for qsort
+///
+/// @param first first code
+/// @param second second code
+/// @return negative, zero or positive
+int compareCodes(const void *first, const void *second);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// maps a word list and keeps its five-letter words in a sorted array of codes, other lines are skipped
+///
+/// @param path path of the word list, one word per line
+/// @param dictionary dictionary to fill
+/// @return ALRIGHT or INVALID_DICTIONARY
+int loadDictionary(const char *path, Dictionary *dictionary);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// looks for a word in the dictionary with a binary search
+///
+/// @param dictionary dictionary
+/// @param word word of five upper case letters
+/// @return index of the word, -1 if it's not there
+int dictionaryIndex(const Dictionary *dictionary, const char *word);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks if a word is in the dictionary
+///
+/// @param dictionary dictionary
+/// @param word word of five upper case letters
+/// @return true if it's there, false if not
+bool inDictionary(const Dictionary *dictionary, const char *word);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// unpacks the code of a word into five upper case letters
+///
+/// @param code code of the word
+/// @param word string of at least 6 characters to fill
+/// @return no return
+void unpackWord(uint32_t code, char *word);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the feedback pattern of a guess, letters in the correct position first, then the other letters of the
+/// guess are marked present from left to right as long as the solution has unmarked copies of them
+///
+/// @param guessed guessed word
+/// @param solution solution
+/// @return pattern code from 0 to PATTERN_COUNT - 1
+int scoreGuess(const char *guessed, const char *solution);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the entropy of the feedback patterns of a guess over the candidates, in bits
+///
+/// @param row patterns of the guess against every word of the dictionary
+/// @param candidates indexes of the candidates
+/// @param count number of candidates
+/// @return entropy
+double patternEntropy(const uint8_t *row, const int *candidates, int count);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the guess with the most entropy over the candidates, candidates win ties since they may be the solution
+///
+/// @param patterns pattern table
+/// @param candidates indexes of the candidates
+/// @param count number of candidates
+/// @param entropy entropy of the best guess to set
+/// @return index of the best guess
+int bestGuess(const Pattern_table *patterns, const int *candidates, int count, double *entropy);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads a little endian number of four bytes
+///
+/// @param bytes bytes
+/// @return number
+uint32_t readNumber(const uint8_t *bytes);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes a number as four little endian bytes
+///
+/// @param bytes bytes to fill
+/// @param number number
+/// @return no return
+void writeNumber(uint8_t *bytes, uint32_t number);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// maps the pattern table of a dictionary, the file is built first if it is missing or is a table of another word
+/// list, any other file is refused
+///
+/// @param path path of the pattern table
+/// @param dictionary dictionary
+/// @param patterns pattern table to fill
+/// @return ALRIGHT or INVALID_DICTIONARY
+int loadPatterns(const char *path, const Dictionary *dictionary, Pattern_table *patterns);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// prints the guess which gives the most information about the solution, from the words which still match the
+/// feedback of all guesses so far
+///
+/// @param words array of already guessed words
+/// @param feedback feedback patterns of the guessed words
+/// @param words_count number of already guessed words
+/// @param dictionary dictionary
+/// @param patterns pattern table of the dictionary
+/// @return no return
+void giveHint(char words[][WORD_LENGTH + 1], const uint8_t *feedback, int words_count,
+              const Dictionary *dictionary, const Pattern_table *patterns);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns 0x80 in every byte of the number which is zero and 0 in every other byte
+///
+/// @param bytes eight bytes
+/// @return mask of the zero bytes
+uint64_t zeroBytes(uint64_t bytes);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// scores a guess like scoreGuess, but on words packed one letter per byte (first letter lowest), so all five
+/// letters are compared to one letter of the other word at once
+///
+/// @param guessed packed guessed word
+/// @param solution packed solution
+/// @return pattern code from 0 to PATTERN_COUNT - 1
+int scorePacked(uint64_t guessed, uint64_t solution);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads a line of a batch, two five-letter words (any case) separated by spaces, tabs or a comma
+///
+/// @param line start of the line
+/// @param end end of the line without its line break
+/// @param guessed packed guessed word to set
+/// @param solution packed solution to set
+/// @return true if the line is a valid pair, false if not
+bool parsePair(const char *line, const char *end, uint64_t *guessed, uint64_t *solution);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// batch thread: writes the feedback pattern of every line of its chunk into its own output buffer
+///
+/// @param argument chunk of the batch
+/// @return NULL
+void *scoreChunk(void *argument);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads a whole stream into memory
+///
+/// @param file file descriptor of the stream
+/// @param size size of the text to set
+/// @return allocated text or NULL if it could not be read
+char *readStream(int file, size_t *size);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// frees the text of a batch read from stdin or unmaps the text of a batch file
+///
+/// @param text text or NULL
+/// @param size size of the text
+/// @param from_stdin true if the text was read from stdin
+/// @return no return
+void releaseText(char *text, size_t size, bool from_stdin);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// scores every pair of a file or of stdin on multiple threads, prints one pattern per line in the order of the
+/// input and reports the throughput on stderr
+///
+/// @param arg command line arguments, arg[1] is --batch
+/// @param count number of command line arguments
+/// @return EOF_INPUT, INVALID_USAGE or INVALID_BATCH
+int runBatch(char **arg, int count);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// removes all whitespaces from the string
@@ -75,24 +304,16 @@ int inputGuess(char *input);
 /// @return no return
 void strCopy(const char *str_from, char *str_into);
 
-//---------------------------------------------------------------------------------------------------------------------
-/// searcher for a character in a string
-///
-/// @param word given string/word
-/// @param c character/letter to find
-/// @return true if it's there, false if not
-bool charInWord(const char *word, char c);
-
 //---------------------------------------------------------------------------------------------------------------------
 /// prints words guessed now and in earlier attempts,
-/// checks letters if they are in the solution or not and if they are in the correct positions
+/// marks their letters from the feedback patterns scored when they were guessed
 ///
-/// @param word_to_guess solution
 /// @param words array of already guessed words
+/// @param feedback feedback patterns of the guessed words
 /// @param words_count number of already guessed words
 /// @param color_mode color mode for printing
 /// @return no return
-void printWords(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode);
+void printWords(char words[][WORD_LENGTH + 1], const uint8_t *feedback, int words_count, int color_mode);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// checks if two strings are equal
@@ -103,25 +324,31 @@ void printWords(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_co
 bool strCompare(const char *word_1, const char *word_2);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// analyses the input returns win if the player guessed the word
+/// analyses the input, scores its feedback pattern once and returns win if the player guessed the word
 ///
 /// @param input input
 /// @param word_to_guess solution
 /// @param words array of already guessed words
+/// @param feedback feedback patterns of the guessed words
 /// @param words_count number of already guessed words
 /// @param color_mode color mode for printing
 /// @return return code
-int guessAnalysis(char *input, char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode);
+int guessAnalysis(char *input, char *word_to_guess, char words[][WORD_LENGTH + 1], uint8_t *feedback,
+                  int words_count, int color_mode);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// contains logic for guessing the word and analyses the input for errors
 ///
 /// @param word_to_guess solution
 /// @param words array of already guessed words
+/// @param feedback feedback patterns of the guessed words
 /// @param words_count number of already guessed words
 /// @param color_mode color mode for printing
+/// @param dictionary word list the guess must be in or NULL
+/// @param patterns pattern table for hints or NULL
 /// @return return code
-int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode);
+int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], uint8_t *feedback, int words_count, int color_mode,
+          const Dictionary *dictionary, const Pattern_table *patterns);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// main function contains solution, array of the guessed words, color mode, attempts and the main loop of the game
@@ -129,34 +356,65 @@ int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, i
 /// @return integer exit code
 int main(int argc, char *argv[])
 {
-  if(!checkCommandLine(argv, argc))
+  if(argc >= 2 && strLen(argv[1]) == 7 && strCompare(argv[1], "--batch"))
   {
-    return INVALID_USAGE;
+    return runBatch(argv, argc);
   }
-  printf("Welcome to Evolving Spelling Puzzle!\n\n");
-  char words[ATTEMPTS][WORD_LENGTH + 1];
   int color_mode = 0;
-  if(argc == 3)
+  const char *dictionary_path = NULL;
+  const char *patterns_path = NULL;
+  if(!checkCommandLine(argv, argc, &color_mode, &dictionary_path, &patterns_path))
+  {
+    return INVALID_USAGE;
+  }
+  Dictionary dictionary = {NULL, 0};
+  Pattern_table patterns = {NULL, 0, 0, 0};
+  if(dictionary_path != NULL)
   {
-    color_mode = atoi(argv[2]);
+    if(loadDictionary(dictionary_path, &dictionary) != ALRIGHT)
+    {
+      return INVALID_DICTIONARY;
+    }
+    if(!inDictionary(&dictionary, argv[1]))
+    {
+      printf("ERROR: Solution is not in the dictionary.\n");
+      free(dictionary.words_);
+      return INVALID_DICTIONARY;
+    }
+    if(patterns_path != NULL && loadPatterns(patterns_path, &dictionary, &patterns) != ALRIGHT)
+    {
+      free(dictionary.words_);
+      return INVALID_DICTIONARY;
+    }
   }
+  printf("Welcome to Evolving Spelling Puzzle!\n\n");
+  char words[ATTEMPTS][WORD_LENGTH + 1];
+  uint8_t feedback[ATTEMPTS];
+  int result = LOSE;
   int attempts = ATTEMPTS;
-  while(attempts > 0)
+  while(attempts > 0 && result == LOSE)
   {
     int words_count = ATTEMPTS - attempts;
-    int guess_return_value = guess(argv[1],words,words_count,color_mode);
-    if(guess_return_value == EOF_INPUT)
+    int guess_return_value = guess(argv[1], words, feedback, words_count, color_mode,
+                                   dictionary_path != NULL ? &dictionary : NULL,
+                                   patterns.file_ != NULL ? &patterns : NULL);
+    if(guess_return_value == EOF_INPUT || guess_return_value == WIN)
     {
-      return EOF_INPUT;
+      result = guess_return_value;
     }
     if(guess_return_value == ALRIGHT)
     {
       attempts--;
     }
-    if(guess_return_value == WIN)
-    {
-      return WIN;
-    }
+  }
+  free(dictionary.words_);
+  if(patterns.file_ != NULL)
+  {
+    munmap(patterns.file_, patterns.size_);
+  }
+  if(result != LOSE)
+  {
+    return result;
   }
   printf("Oh no! You did not guess the word correctly! :(\n");
   printf("The solution was: '%s'!\n",argv[1]);
@@ -213,32 +471,712 @@ bool checkColorMode(const char *color_mode)
 
 
 //return true if okay, false if not. Double pointer: pointer to an array of pointers to char
-bool checkCommandLine(char **arg, int count)
+bool checkCommandLine(char **arg, int count, int *color_mode, const char **dictionary_path,
+                      const char **patterns_path)
 {
-  if(count != 2 && count != 3)
+  // the color mode is the first argument after the solution which is not an option with its file
+  const char *color_argument = NULL;
+  bool valid = count >= 2;
+  for(int i = 2; i < count && valid; i++)
   {
-    printf("Usage: ./a2 <solution> [optional: color_enabled]\n");
+    const char **path = NULL;
+    if(strLen(arg[i]) == 6 && strCompare(arg[i], "--dict"))
+    {
+      path = dictionary_path;
+    }
+    if(strLen(arg[i]) == 10 && strCompare(arg[i], "--patterns"))
+    {
+      path = patterns_path;
+    }
+    if(path != NULL)
+    {
+      valid = i + 1 < count && *path == NULL;
+      *path = valid ? arg[i + 1] : NULL;
+      i++;
+    }
+    else
+    {
+      valid = color_argument == NULL;
+      color_argument = arg[i];
+    }
+  }
+  if(!valid || (*patterns_path != NULL && *dictionary_path == NULL))
+  {
+    printf("Usage: ./a2 <solution> [optional: color_enabled] [optional: --dict <word list> "
+           "[optional: --patterns <pattern table>]]\n");
     return false;
   }
+  if(!checkSolution(arg[1]))
+  {
+    return false;
+  }
+  if(color_argument != NULL)
+  {
+    if(!checkColorMode(color_argument))
+    {
+      return false;
+    }
+    *color_mode = *color_argument - '0';
+  }
+  return true;
+}
 
+uint32_t packWord(const char *word)
+{
+  uint32_t code = 0;
+  for(int i = 0; i < WORD_LENGTH; i++)
+  {
+    code = code << LETTER_BITS | (uint32_t)(word[i] - 'A');
+  }
+  return code;
+}
+
+int compareCodes(const void *first, const void *second)
+{
+  uint32_t code_1 = *(const uint32_t *)first;
+  uint32_t code_2 = *(const uint32_t *)second;
+  return (code_1 > code_2) - (code_1 < code_2);
+}
+
+int loadDictionary(const char *path, Dictionary *dictionary)
+{
+  int file = open(path, O_RDONLY);
+  struct stat status;
+  if(file < 0 || fstat(file, &status) != 0 || status.st_size == 0)
+  {
+    printf("ERROR: Cannot read the dictionary '%s'.\n", path);
+    if(file >= 0)
+    {
+      close(file);
+    }
+    return INVALID_DICTIONARY;
+  }
+  size_t size = (size_t)status.st_size;
+  const char *text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  // every five-letter word takes at least six bytes with its line break
+  dictionary->words_ = text != MAP_FAILED ? malloc((size / (WORD_LENGTH + 1) + 1) * sizeof(uint32_t)) : NULL;
+  if(dictionary->words_ == NULL)
+  {
+    printf("ERROR: Cannot read the dictionary '%s'.\n", path);
+    if(text != MAP_FAILED)
+    {
+      munmap((void *)text, size);
+    }
+    return INVALID_DICTIONARY;
+  }
+  dictionary->count_ = 0;
+  size_t position = 0;
+  while(position < size)
+  {
+    size_t line_end = position;
+    while(line_end < size && text[line_end] != '\n')
+    {
+      line_end++;
+    }
+    size_t length = line_end - position;
+    if(length > 0 && text[line_end - 1] == '\r')
+    {
+      length--;
+    }
+    char word[WORD_LENGTH + 1];
+    bool valid = length == WORD_LENGTH;
+    for(size_t i = 0; i < WORD_LENGTH && valid; i++)
+    {
+      char c = text[position + i];
+      word[i] = (c >= 'a' && c <= 'z') ? (char)(c - 32) : c;
+      valid = word[i] >= 'A' && word[i] <= 'Z';
+    }
+    if(valid)
+    {
+      dictionary->words_[dictionary->count_++] = packWord(word);
+    }
+    position = line_end + 1;
+  }
+  munmap((void *)text, size);
+  qsort(dictionary->words_, dictionary->count_, sizeof(uint32_t), compareCodes);
+  int unique = 0;
+  for(int i = 0; i < dictionary->count_; i++)
+  {
+    if(unique == 0 || dictionary->words_[unique - 1] != dictionary->words_[i])
+    {
+      dictionary->words_[unique++] = dictionary->words_[i];
+    }
+  }
+  dictionary->count_ = unique;
+  if(unique == 0)
+  {
+    printf("ERROR: The dictionary '%s' has no five-letter words.\n", path);
+    free(dictionary->words_);
+    dictionary->words_ = NULL;
+    return INVALID_DICTIONARY;
+  }
+  return ALRIGHT;
+}
+
+int dictionaryIndex(const Dictionary *dictionary, const char *word)
+{
+  uint32_t code = packWord(word);
+  int low = 0;
+  int high = dictionary->count_;
+  while(low < high)
+  {
+    int middle = low + (high - low) / 2;
+    if(dictionary->words_[middle] < code)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return low < dictionary->count_ && dictionary->words_[low] == code ? low : -1;
+}
+
+bool inDictionary(const Dictionary *dictionary, const char *word)
+{
+  return dictionaryIndex(dictionary, word) >= 0;
+}
+
+void unpackWord(uint32_t code, char *word)
+{
+  for(int i = WORD_LENGTH - 1; i >= 0; i--)
+  {
+    word[i] = (char)('A' + (code & ((1 << LETTER_BITS) - 1)));
+    code >>= LETTER_BITS;
+  }
+  word[WORD_LENGTH] = '\0';
+}
+
+int scoreGuess(const char *guessed, const char *solution)
+{
+  int unmatched[26] = {0};
+  int marks[WORD_LENGTH] = {0};
+  for(int i = 0; i < WORD_LENGTH; i++)
+  {
+    if(guessed[i] == solution[i])
+    {
+      marks[i] = 2;
+    }
+    else
+    {
+      unmatched[solution[i] - 'A']++;
+    }
+  }
+  int pattern = 0;
+  for(int i = 0; i < WORD_LENGTH; i++)
+  {
+    if(marks[i] == 0 && unmatched[guessed[i] - 'A'] > 0)
+    {
+      unmatched[guessed[i] - 'A']--;
+      marks[i] = 1;
+    }
+    pattern = pattern * 3 + marks[i];
+  }
+  return pattern;
+}
+
+double patternEntropy(const uint8_t *row, const int *candidates, int count)
+{
+  int buckets[PATTERN_COUNT] = {0};
   for(int i = 0; i < count; i++)
   {
-    if(i == 1)
+    buckets[row[candidates[i]]]++;
+  }
+  // sum of -p * log2(p) with p = bucket / count
+  double sum = 0;
+  for(int pattern = 0; pattern < PATTERN_COUNT; pattern++)
+  {
+    if(buckets[pattern] > 0)
     {
-      if(!checkSolution(arg[i]))
+      sum += buckets[pattern] * log2(buckets[pattern]);
+    }
+  }
+  return log2(count) - sum / count;
+}
+
+int bestGuess(const Pattern_table *patterns, const int *candidates, int count, double *entropy)
+{
+  const uint8_t *rows = patterns->file_ + PATTERN_HEADER;
+  int best = candidates[0];
+  bool best_candidate = true;
+  *entropy = patternEntropy(rows + (size_t)best * patterns->count_, candidates, count);
+  int next_candidate = 0;
+  for(int word = 0; word < patterns->count_; word++)
+  {
+    // the candidates are sorted like the words, so this tells if the word is one of them
+    bool candidate = next_candidate < count && candidates[next_candidate] == word;
+    next_candidate += candidate;
+    double word_entropy = patternEntropy(rows + (size_t)word * patterns->count_, candidates, count);
+    // on a tie a word that can still be the solution wins
+    if(word_entropy > *entropy + 1e-9 || (candidate && !best_candidate && word_entropy > *entropy - 1e-9))
+    {
+      best = word;
+      best_candidate = candidate;
+      *entropy = word_entropy;
+    }
+  }
+  return best;
+}
+
+uint32_t readNumber(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+void writeNumber(uint8_t *bytes, uint32_t number)
+{
+  for(int i = 0; i < 4; i++)
+  {
+    bytes[i] = (uint8_t)(number >> (8 * i));
+  }
+}
+
+int loadPatterns(const char *path, const Dictionary *dictionary, Pattern_table *patterns)
+{
+  // FNV-1a over the word codes, so a table of another word list is never used
+  uint32_t checksum = 2166136261u;
+  for(int i = 0; i < dictionary->count_; i++)
+  {
+    checksum = (checksum ^ dictionary->words_[i]) * 16777619u;
+  }
+  size_t count = (size_t)dictionary->count_;
+  size_t size = PATTERN_HEADER + count * count;
+  int file = open(path, O_RDONLY);
+  if(file < 0 && errno != ENOENT)
+  {
+    printf("ERROR: Cannot read the pattern table '%s'.\n", path);
+    return INVALID_DICTIONARY;
+  }
+  if(file >= 0)
+  {
+    // only a pattern table may be replaced, any other file is left alone
+    uint8_t magic[4] = {0};
+    struct stat info;
+    bool table = fstat(file, &info) == 0 && read(file, magic, 4) == 4 && magic[0] == PATTERN_MAGIC[0] &&
+                 magic[1] == PATTERN_MAGIC[1] && magic[2] == PATTERN_MAGIC[2] && magic[3] == PATTERN_MAGIC[3];
+    uint8_t *map = table && (size_t)info.st_size == size ? mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0)
+                                                         : MAP_FAILED;
+    close(file);
+    if(map != MAP_FAILED && readNumber(map + 4) == count && readNumber(map + 8) == checksum &&
+       readNumber(map + 12) < count)
+    {
+      *patterns = (Pattern_table){map, size, (int)count, (int)readNumber(map + 12)};
+      return ALRIGHT;
+    }
+    if(map != MAP_FAILED)
+    {
+      munmap(map, size);
+    }
+    if(!table)
+    {
+      printf("ERROR: '%s' is not a pattern table.\n", path);
+      return INVALID_DICTIONARY;
+    }
+  }
+  if(count > MAX_PATTERN_WORDS)
+  {
+    printf("ERROR: The dictionary has more than %d words for a pattern table.\n", MAX_PATTERN_WORDS);
+    return INVALID_DICTIONARY;
+  }
+  // the table is built next to the path and renamed into place when it is finished, so a failed build never
+  // replaces anything
+  int path_length = strLen(path);
+  char *build_path = malloc((size_t)path_length + 5);
+  if(build_path == NULL)
+  {
+    printf("ERROR: Out of memory.\n");
+    return INVALID_DICTIONARY;
+  }
+  strCopy(path, build_path);
+  strCopy(".tmp", build_path + path_length);
+  file = open(build_path, O_RDWR | O_CREAT | O_EXCL, 0644);
+  uint8_t *map = MAP_FAILED;
+  if(file >= 0 && ftruncate(file, (off_t)size) == 0)
+  {
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  }
+  if(file >= 0)
+  {
+    close(file);
+  }
+  int *candidates = malloc(count * sizeof(int));
+  if(map == MAP_FAILED || candidates == NULL)
+  {
+    if(file < 0 && errno == EEXIST)
+    {
+      printf("ERROR: '%s' exists, remove it if no other build of the pattern table is running.\n", build_path);
+    }
+    else
+    {
+      printf("ERROR: Cannot write the pattern table '%s'.\n", build_path);
+    }
+    if(file >= 0)
+    {
+      unlink(build_path);
+    }
+    if(map != MAP_FAILED)
+    {
+      munmap(map, size);
+    }
+    free(candidates);
+    free(build_path);
+    return INVALID_DICTIONARY;
+  }
+  char guessed[WORD_LENGTH + 1];
+  char answer[WORD_LENGTH + 1];
+  for(size_t row = 0; row < count; row++)
+  {
+    unpackWord(dictionary->words_[row], guessed);
+    for(size_t column = 0; column < count; column++)
+    {
+      unpackWord(dictionary->words_[column], answer);
+      map[PATTERN_HEADER + row * count + column] = (uint8_t)scoreGuess(guessed, answer);
+    }
+  }
+  for(size_t i = 0; i < count; i++)
+  {
+    candidates[i] = (int)i;
+  }
+  *patterns = (Pattern_table){map, size, (int)count, 0};
+  double entropy;
+  patterns->opening_ = bestGuess(patterns, candidates, (int)count, &entropy);
+  free(candidates);
+  writeNumber(map + 4, (uint32_t)count);
+  writeNumber(map + 8, checksum);
+  writeNumber(map + 12, (uint32_t)patterns->opening_);
+  for(int i = 0; i < 4; i++)
+  {
+    map[i] = (uint8_t)PATTERN_MAGIC[i];
+  }
+  if(msync(map, size, MS_SYNC) != 0 || rename(build_path, path) != 0)
+  {
+    printf("ERROR: Cannot write the pattern table '%s'.\n", path);
+    unlink(build_path);
+    munmap(map, size);
+    patterns->file_ = NULL;
+    free(build_path);
+    return INVALID_DICTIONARY;
+  }
+  free(build_path);
+  return ALRIGHT;
+}
+
+void giveHint(char words[][WORD_LENGTH + 1], const uint8_t *feedback, int words_count,
+              const Dictionary *dictionary, const Pattern_table *patterns)
+{
+  const uint8_t *rows = patterns->file_ + PATTERN_HEADER;
+  int *candidates = malloc((size_t)patterns->count_ * sizeof(int));
+  if(candidates == NULL)
+  {
+    printf("ERROR: Out of memory.\n\n");
+    return;
+  }
+  const uint8_t *guess_rows[ATTEMPTS];
+  for(int i = 0; i < words_count; i++)
+  {
+    guess_rows[i] = rows + (size_t)dictionaryIndex(dictionary, words[i]) * patterns->count_;
+  }
+  // the candidates are the words which would have given the same feedback to every guess so far
+  int left = 0;
+  for(int word = 0; word < patterns->count_; word++)
+  {
+    bool matches = true;
+    for(int i = 0; i < words_count && matches; i++)
+    {
+      matches = guess_rows[i][word] == feedback[i];
+    }
+    if(matches)
+    {
+      candidates[left++] = word;
+    }
+  }
+  int best = patterns->opening_;
+  double entropy;
+  if(words_count == 0)
+  {
+    entropy = patternEntropy(rows + (size_t)best * patterns->count_, candidates, left);
+  }
+  else
+  {
+    best = bestGuess(patterns, candidates, left, &entropy);
+  }
+  free(candidates);
+  char hint[WORD_LENGTH + 1];
+  unpackWord(dictionary->words_[best], hint);
+  printf("Hint: %s (%.2f bits, %d %s left)\n\n", hint, entropy, left, left == 1 ? "word" : "words");
+}
+
+uint64_t zeroBytes(uint64_t bytes)
+{
+  const uint64_t low_bits = 0x7F7F7F7F7F7F7F7Full;
+  // adding the low bits sets the high bit of every byte with a low bit set, the high bit itself is or-ed in
+  return ~(((bytes & low_bits) + low_bits) | bytes | low_bits);
+}
+
+int scorePacked(uint64_t guessed, uint64_t solution)
+{
+  const uint64_t letters = 0x0000008080808080ull;
+  uint64_t correct = zeroBytes(guessed ^ solution) & letters;
+  if(correct == letters)
+  {
+    return PATTERN_COUNT - 1;
+  }
+  // letters of the solution which can still mark a letter of the guess as present
+  uint64_t unmatched = letters & ~correct;
+  int pattern = 0;
+  for(int i = 0; i < WORD_LENGTH; i++)
+  {
+    int mark = 0;
+    if(correct & (0x80ull << (8 * i)))
+    {
+      mark = 2;
+    }
+    else
+    {
+      uint64_t letter = ((guessed >> (8 * i)) & 0xFF) * 0x0101010101010101ull;
+      uint64_t same = zeroBytes(solution ^ letter) & unmatched;
+      if(same != 0)
       {
-        return false;
+        // the first unmatched copy of the letter is used up
+        unmatched &= ~(same & (~same + 1));
+        mark = 1;
       }
     }
-    if(i == 2)
+    pattern = pattern * 3 + mark;
+  }
+  return pattern;
+}
+
+bool parsePair(const char *line, const char *end, uint64_t *guessed, uint64_t *solution)
+{
+  if(end > line && end[-1] == '\r')
+  {
+    end--;
+  }
+  uint64_t *words[2] = {guessed, solution};
+  for(int word = 0; word < 2; word++)
+  {
+    while(line < end && (*line == ' ' || *line == '\t' || (*line == ',' && word == 1)))
+    {
+      line++;
+    }
+    uint64_t packed = 0;
+    for(int i = 0; i < WORD_LENGTH; i++, line++)
     {
-      if(!checkColorMode(arg[i]))
+      char c = line < end && *line >= 'a' && *line <= 'z' ? (char)(*line - 32) : line < end ? *line : '\0';
+      if(c < 'A' || c > 'Z')
       {
         return false;
       }
+      packed |= (uint64_t)(uint8_t)c << (8 * i);
+    }
+    *words[word] = packed;
+    if(line < end && *line != ' ' && *line != '\t' && *line != ',')
+    {
+      return false;
     }
   }
-  return true;
+  while(line < end && (*line == ' ' || *line == '\t'))
+  {
+    line++;
+  }
+  return line == end;
+}
+
+void *scoreChunk(void *argument)
+{
+  Batch_chunk *chunk = argument;
+  size_t lines = chunk->end_ > chunk->begin_ && chunk->end_[-1] != '\n';
+  for(const char *c = chunk->begin_; c < chunk->end_; c++)
+  {
+    lines += *c == '\n';
+  }
+  chunk->output_ = malloc(lines * (WORD_LENGTH + 1) + 1);
+  if(chunk->output_ == NULL)
+  {
+    return NULL;
+  }
+  const char *line = chunk->begin_;
+  while(line < chunk->end_)
+  {
+    const char *line_end = line;
+    while(line_end < chunk->end_ && *line_end != '\n')
+    {
+      line_end++;
+    }
+    char *mark = chunk->output_ + chunk->length_;
+    uint64_t guessed;
+    uint64_t solution;
+    if(parsePair(line, line_end, &guessed, &solution))
+    {
+      int pattern = scorePacked(guessed, solution);
+      for(int i = WORD_LENGTH - 1; i >= 0; i--)
+      {
+        mark[i] = ".~*"[pattern % 3];
+        pattern /= 3;
+      }
+      chunk->pairs_++;
+    }
+    else
+    {
+      strCopy("ERROR", mark);
+      chunk->errors_++;
+    }
+    mark[WORD_LENGTH] = '\n';
+    chunk->length_ += WORD_LENGTH + 1;
+    line = line_end + 1;
+  }
+  return NULL;
+}
+
+void releaseText(char *text, size_t size, bool from_stdin)
+{
+  if(text != NULL && from_stdin)
+  {
+    free(text);
+  }
+  if(text != NULL && !from_stdin)
+  {
+    munmap(text, size);
+  }
+}
+
+char *readStream(int file, size_t *size)
+{
+  size_t capacity = 1 << 16;
+  char *text = malloc(capacity);
+  *size = 0;
+  ssize_t length;
+  while(text != NULL && (length = read(file, text + *size, capacity - *size)) > 0)
+  {
+    *size += (size_t)length;
+    if(*size == capacity)
+    {
+      capacity *= 2;
+      char *bigger = realloc(text, capacity);
+      if(bigger == NULL)
+      {
+        free(text);
+      }
+      text = bigger;
+    }
+  }
+  if(text != NULL && length < 0)
+  {
+    free(text);
+    text = NULL;
+  }
+  return text;
+}
+
+int runBatch(char **arg, int count)
+{
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool valid = count == 3;
+  if(count == 5 && strLen(arg[3]) == 9 && strCompare(arg[3], "--threads"))
+  {
+    char *number_end;
+    threads = strtol(arg[4], &number_end, 10);
+    valid = number_end != arg[4] && *number_end == '\0' && threads >= 1 && threads <= MAX_BATCH_THREADS;
+  }
+  if(!valid)
+  {
+    printf("Usage: ./a2 --batch <file of guess and solution pairs or - for stdin> [optional: --threads <count>]\n");
+    return INVALID_USAGE;
+  }
+  threads = threads < 1 ? 1 : threads > MAX_BATCH_THREADS ? MAX_BATCH_THREADS : threads;
+  // stdin is read into memory, a file is mapped
+  bool from_stdin = strLen(arg[2]) == 1 && strCompare(arg[2], "-");
+  size_t size = 0;
+  char *text = NULL;
+  if(from_stdin)
+  {
+    text = readStream(STDIN_FILENO, &size);
+    valid = text != NULL;
+  }
+  else
+  {
+    int file = open(arg[2], O_RDONLY);
+    struct stat status;
+    valid = file >= 0 && fstat(file, &status) == 0;
+    size = valid ? (size_t)status.st_size : 0;
+    if(size > 0)
+    {
+      text = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+      valid = text != MAP_FAILED;
+      text = valid ? text : NULL;
+    }
+    if(file >= 0)
+    {
+      close(file);
+    }
+  }
+  Batch_chunk *chunks = valid ? calloc((size_t)threads, sizeof(Batch_chunk)) : NULL;
+  if(chunks == NULL)
+  {
+    printf("ERROR: Cannot read the batch '%s'.\n", arg[2]);
+    releaseText(text, size, from_stdin);
+    return INVALID_BATCH;
+  }
+  // the chunks are about the same size and end after a line break, so no line is split between threads
+  const char *begin = text;
+  for(long i = 0; i < threads && size > 0; i++)
+  {
+    const char *end = text + size * (size_t)(i + 1) / (size_t)threads;
+    while(end > begin && end < text + size && end[-1] != '\n')
+    {
+      end++;
+    }
+    chunks[i].begin_ = begin;
+    chunks[i].end_ = end > begin ? end : begin;
+    begin = chunks[i].end_;
+  }
+  struct timespec start;
+  struct timespec stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(long i = 0; i < threads; i++)
+  {
+    chunks[i].started_ = pthread_create(&chunks[i].thread_, NULL, scoreChunk, &chunks[i]) == 0;
+    if(!chunks[i].started_)
+    {
+      scoreChunk(&chunks[i]);
+    }
+  }
+  long pairs = 0;
+  long errors = 0;
+  for(long i = 0; i < threads; i++)
+  {
+    if(chunks[i].started_)
+    {
+      pthread_join(chunks[i].thread_, NULL);
+    }
+    valid = valid && (chunks[i].output_ != NULL || chunks[i].begin_ == chunks[i].end_);
+    pairs += chunks[i].pairs_;
+    errors += chunks[i].errors_;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  for(long i = 0; i < threads && valid; i++)
+  {
+    fwrite(chunks[i].output_, 1, chunks[i].length_, stdout);
+  }
+  for(long i = 0; i < threads; i++)
+  {
+    free(chunks[i].output_);
+  }
+  free(chunks);
+  releaseText(text, size, from_stdin);
+  if(!valid)
+  {
+    printf("ERROR: Out of memory.\n");
+    return INVALID_BATCH;
+  }
+  double seconds = (double)(stop.tv_sec - start.tv_sec) + (double)(stop.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf(stderr, "Scored %ld pairs (%ld invalid lines) on %ld threads in %.3f s (%.0f pairs/s)\n", pairs, errors,
+          threads, seconds, seconds > 0 ? pairs / seconds : 0.0);
+  // like a game, the batch ends with the end of its input
+  return EOF_INPUT;
 }
 
 void removeWhitespaces(char *str)
@@ -288,29 +1226,22 @@ void strCopy(const char *str_from, char *str_into)
   str_into[index] = '\0';
 }
 
-bool charInWord(const char *word, char c)
+void printWords(char words[][WORD_LENGTH + 1], const uint8_t *feedback, int words_count, int color_mode)
 {
-  int index = 0;
-  while(word[index] != '\0')
+  for(int i = 0; i < words_count + 1; i++)
   {
-    if(word[index] == c)
+    // the digits of the pattern are the marks of the letters, the last letter is the lowest digit
+    int marks[WORD_LENGTH];
+    int pattern = feedback[i];
+    for(int index = WORD_LENGTH - 1; index >= 0; index--)
     {
-      return true;
+      marks[index] = pattern % 3;
+      pattern /= 3;
     }
-    index++;
-  }
-  return false;
-}
-
-void printWords(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode)
-{
-  for(int i = 0; i < words_count + 1; i++)
-  {
     printf("|");
-    int index = 0;
-    while(words[i][index] != '\0')
+    for(int index = 0; index < WORD_LENGTH; index++)
     {
-      if(word_to_guess[index] == words[i][index])
+      if(marks[index] == 2)
       {
         if(color_mode == 0)
         {
@@ -321,7 +1252,7 @@ void printWords(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_co
           printf("  " ANSI_COLOR_BLUE "%c" ANSI_COLOR_RESET, words[i][index]);
         }
       }
-      else if(charInWord(word_to_guess,words[i][index]))
+      else if(marks[index] == 1)
       {
         if(color_mode == 0)
         {
@@ -336,7 +1267,6 @@ void printWords(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_co
       {
         printf("  %c",words[i][index]);
       }
-      index++;
     }
     printf("\n");
   }
@@ -357,10 +1287,12 @@ bool strCompare(const char *word_1, const char *word_2)
   return true;
 }
 
-int guessAnalysis(char *input, char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode)
+int guessAnalysis(char *input, char *word_to_guess, char words[][WORD_LENGTH + 1], uint8_t *feedback,
+                  int words_count, int color_mode)
 {
   strCopy(input,words[words_count]);
-  printWords(word_to_guess, words, words_count, color_mode);
+  feedback[words_count] = (uint8_t)scoreGuess(words[words_count], word_to_guess);
+  printWords(words, feedback, words_count, color_mode);
   if(strCompare(word_to_guess,words[words_count]))
   {
     printf("Good job! You solved this puzzle!\n");
@@ -372,7 +1304,8 @@ int guessAnalysis(char *input, char *word_to_guess, char words[][WORD_LENGTH + 1
   }
 }
 
-int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, int color_mode)
+int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], uint8_t *feedback, int words_count, int color_mode,
+          const Dictionary *dictionary, const Pattern_table *patterns)
 {
   printf("Please enter your guess:\n > ");
   char input[GUESS_INPUT_SIZE + 1];
@@ -381,6 +1314,16 @@ int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, i
     return EOF_INPUT;
   }
   removeWhitespaces(input);
+  if(strLen(input) == 4 && (strCompare(input, "hint") || strCompare(input, "HINT")))
+  {
+    if(patterns == NULL)
+    {
+      printf("ERROR: A hint needs --dict <word list> and --patterns <pattern table>.\n\n");
+      return INPUT_ERROR;
+    }
+    giveHint(words, feedback, words_count, dictionary, patterns);
+    return HINT;
+  }
   if(strLen(input) != 5)
   {
     printf("ERROR: Word is not 5 characters long.\n\n");
@@ -398,5 +1341,10 @@ int guess(char *word_to_guess, char words[][WORD_LENGTH + 1], int words_count, i
       input[i] = input[i] - 32;
     }
   }
-  return guessAnalysis(input, word_to_guess, words, words_count, color_mode);
+  if(dictionary != NULL && !inDictionary(dictionary, input))
+  {
+    printf("ERROR: Word is not in the dictionary.\n\n");
+    return INPUT_ERROR;
+  }
+  return guessAnalysis(input, word_to_guess, words, feedback, words_count, color_mode);
 }
@@ -1,13 +1,39 @@
 //---------------------------------------------------------------------------------------------------------------------
 // This program is a game called Minesweeper
 //---------------------------------------------------------------------------------------------------------------------
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 #define INPUT_SIZE 10000
 #define ARGUMENT_SIZE 10000
+#define AUTOSAVE_INTERVAL 2
+
+//instrumentation of the commands, only compiled in with -DMINESWEEPER_STATS
+#ifdef MINESWEEPER_STATS
+#define STATS_SUB_BITS 3
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS (64 * STATS_SUB_BUCKETS)
+#define STATS_SAMPLE(sample) StatsSample sample
+#define STATS_BEGIN(game, sample) statsBegin((game), &(sample))
+#define STATS_END(game, command, sample) statsEnd((game), (command), &(sample))
+#define STATS_CELLS(game, count) ((game)->stats_.cells_ += (count))
+#define STATS_BYTES(game, count) ((game)->stats_.bytes_ += (count))
+#define STATS_PRINTF(game, ...) ((game)->stats_.bytes_ += printf(__VA_ARGS__))
+#else
+#define STATS_SAMPLE(sample)
+#define STATS_BEGIN(game, sample) ((void)0)
+#define STATS_END(game, command, sample) ((void)0)
+#define STATS_CELLS(game, count) ((void)0)
+#define STATS_BYTES(game, count) ((void)0)
+#define STATS_PRINTF(game, ...) printf(__VA_ARGS__)
+#endif
 
 enum returnCodes
 {
@@ -29,6 +55,61 @@ typedef struct _field_
   int adj_mines_;
 } Field;
 
+#ifdef MINESWEEPER_STATS
+enum statsCommands
+{
+  STATS_START = 0,
+  STATS_OPEN = 1,
+  STATS_FLAG = 2,
+  STATS_SAVE = 3,
+  STATS_LOAD = 4,
+  STATS_PRINT_MAP = 5,
+  STATS_COMMANDS = 6,
+};
+
+typedef struct _command_stats_
+{
+  long long count_;
+  long long total_ns_;
+  long long min_ns_;
+  long long max_ns_;
+  long long cells_;
+  long long bytes_;
+  long long histogram_[STATS_BUCKETS];
+} CommandStats;
+
+typedef struct _stats_
+{
+  CommandStats commands_[STATS_COMMANDS];
+  long long cells_;
+  long long bytes_;
+  char path_[ARGUMENT_SIZE];
+} Stats;
+
+typedef struct _stats_sample_
+{
+  struct timespec start_;
+  long long cells_;
+  long long bytes_;
+} StatsSample;
+#endif
+
+//snapshot written by the autosave thread; rows stay shared with the map until the game changes them
+typedef struct _autosave_
+{
+  char path_[ARGUMENT_SIZE];
+  time_t last_;
+  bool dirty_;
+  bool in_flight_;
+  atomic_bool done_;
+  pthread_t thread_;
+
+  Field **map_;
+  bool *shared_;
+  long long rows_;
+  long long cols_;
+} Autosave;
+
 typedef struct _game_
 {
   long long rows_;
@@ -37,11 +118,22 @@ typedef struct _game_
   long long seed_;
 
   bool running_;
+  bool safe_area_;
   Field **map_;
 
   long long fields_no_mine_;
   long long opened_fields_;
   long long remaining_flags_;
+
+  long long bbbv_;
+  long long openings_;
+  long long largest_opening_;
+
+  Autosave autosave_;
+
+#ifdef MINESWEEPER_STATS
+  Stats stats_;
+#endif
 } Game;
 
 
@@ -176,6 +268,39 @@ unsigned long long int generate_64bit_random_number();
 //
 void setAdjMines(Game *game);
 
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// finds the root of the opening a zero field belongs to; part of board metrics
+///
+/// @param long long * parent union-find array, roots hold the negative opening size
+/// @param long long field index of the field
+///
+/// @return long long index of the root field
+//
+long long findOpening(long long *parent, long long field);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// joins the openings of two zero fields; part of board metrics
+///
+/// @param long long * parent union-find array, roots hold the negative opening size
+/// @param long long field_1 index of the first field
+/// @param long long field_2 index of the second field
+///
+/// @return no return
+//
+void joinOpenings(long long *parent, long long field_1, long long field_2);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// computes 3BV, number of openings and size of the largest opening with a union-find labeling of the board
+///
+/// @param Game * main game struct
+///
+/// @return int code for error or continue
+//
+int computeBoardMetrics(Game *game);
+
 //---------------------------------------------------------------------------------------------------------------------
 ///
 /// flags a field or removes flag if its flagged
@@ -234,6 +359,25 @@ void openFieldsAround(Game *game, long long row, long long col);
 //
 void open(Game *game, long long row, long long col);
 
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// sets random fields outside of the safe area to the given mine state until count fields were changed;
+/// part of map generation, expected number of tries stays below 2 * count as long as count is at most half
+/// of the fields outside of the safe area
+///
+/// @param Game * main game struct
+/// @param long long count number of fields to change
+/// @param bool mine new mine state of the fields
+/// @param long long safe_top first row of the safe area
+/// @param long long safe_left first col of the safe area
+/// @param long long safe_bottom last row of the safe area
+/// @param long long safe_right last col of the safe area
+///
+/// @return no return
+//
+void placeRandomFields(Game *game, long long count, bool mine, long long safe_top, long long safe_left,
+                       long long safe_bottom, long long safe_right);
+
 //---------------------------------------------------------------------------------------------------------------------
 ///
 /// generates map and opens one field
@@ -242,9 +386,9 @@ void open(Game *game, long long row, long long col);
 /// @param long long start_row
 /// @param long long start_col
 ///
-/// @return no return
+/// @return int code for error or continue
 //
-void mapGeneration(Game *game, long long start_row, long long start_col);
+int mapGeneration(Game *game, long long start_row, long long start_col);
 
 //---------------------------------------------------------------------------------------------------------------------
 ///
@@ -254,13 +398,13 @@ void mapGeneration(Game *game, long long start_row, long long start_col);
 /// @param long long start_row
 /// @param long long start_col
 ///
-/// @return no return
+/// @return int code for error or continue
 //
-void startGame(Game *game, long long start_row, long long start_col);
+int startGame(Game *game, long long start_row, long long start_col);
 
 //---------------------------------------------------------------------------------------------------------------------
 ///
-/// prints opened map
+/// prints opened map and the difficulty metrics of the board
 ///
 /// @param Game main game struct
 ///
@@ -268,6 +412,19 @@ void startGame(Game *game, long long start_row, long long start_col);
 //
 void dump(Game *game);
 
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// writes the map in the save file format
+///
+/// @param FILE * file opened for binary writing
+/// @param Field ** map rows of the map
+/// @param long long rows
+/// @param long long cols
+///
+/// @return bool true if everything was written
+//
+bool writeSaveData(FILE *file, Field **map, long long rows, long long cols);
+
 //---------------------------------------------------------------------------------------------------------------------
 ///
 /// saves game
@@ -279,6 +436,57 @@ void dump(Game *game);
 //
 void save(Game *game, char *path);
 
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// returns a row of the map that can be changed; copies the row first if the autosave thread still reads it
+///
+/// @param Game * main game struct
+/// @param long long row
+///
+/// @return Field * row of the map
+//
+Field *writableRow(Game *game, long long row);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// writes the autosave snapshot into a temporary file and renames it over the autosave file; autosave thread
+///
+/// @param void * autosave Autosave struct of the game
+///
+/// @return void * always NULL
+//
+void *autosaveThread(void *autosave);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// takes a snapshot of the map by sharing its rows and starts the autosave thread
+///
+/// @param Game * main game struct
+///
+/// @return no return
+//
+void autosaveStart(Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// waits for the autosave thread and frees the rows only the snapshot still uses
+///
+/// @param Game * main game struct
+///
+/// @return no return
+//
+void autosaveFinish(Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// cleans up a finished autosave and starts a new one if the game changed and the interval has passed
+///
+/// @param Game * main game struct
+///
+/// @return no return
+//
+void autosavePoll(Game *game);
+
 //---------------------------------------------------------------------------------------------------------------------
 ///
 /// counts how many mines are on the field
@@ -331,13 +539,80 @@ int load(Game *game, char *path);
 int execute(Game *game);
 
 
+#ifdef MINESWEEPER_STATS
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// starts measuring a command
+///
+/// @param Game * main game struct
+/// @param StatsSample * sample to start
+///
+/// @return no return
+//
+void statsBegin(Game *game, StatsSample *sample);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// finishes measuring a command and records time, cells touched and bytes written
+///
+/// @param Game * main game struct
+/// @param int command one of statsCommands
+/// @param StatsSample * sample started by statsBegin
+///
+/// @return no return
+//
+void statsEnd(Game *game, int command, StatsSample *sample);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// returns the histogram bucket of a latency, buckets are exact up to 8 ns and have 3 bits of precision above
+///
+/// @param long long ns latency in nanoseconds
+///
+/// @return int bucket index
+//
+int statsBucket(long long ns);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// returns the lowest latency of a histogram bucket
+///
+/// @param int bucket bucket index
+///
+/// @return long long latency in nanoseconds
+//
+long long statsBucketValue(int bucket);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// returns a percentile of the latency histogram of a command
+///
+/// @param CommandStats * stats of the command
+/// @param double percentile between 0 and 100
+///
+/// @return long long latency in nanoseconds
+//
+long long statsPercentile(CommandStats *stats, double percentile);
+
+//---------------------------------------------------------------------------------------------------------------------
+///
+/// prints the statistics of all commands to the stats file or to stdout if no file was given
+///
+/// @param Game * main game struct
+///
+/// @return no return
+//
+void statsDump(Game *game);
+#endif
+
+
 //---main function-----------------------------------------------------------------------------------------------------
 
 
-//main function. The program receives three optional command line arguments: --size, --mines and --seed
+//main function. The program receives optional command line arguments: --size, --mines, --seed and --safe-area
 //---------------------------------------------------------------------------------------------------------------------
 ///
-/// main function. The program receives three optional command line arguments: --size, --mines and --seed
+/// main function. The program receives optional command line arguments: --size, --mines, --seed and --safe-area
 ///
 /// @param int argc
 /// @param char * argv[]
@@ -378,7 +653,18 @@ int main(int argc, char *argv[])
       printf("Out of memory!\n");
       return 1;
     }
+    autosavePoll(&game);
   }
+  //last state of the game is always written before exiting
+  autosaveFinish(&game);
+  if(game.autosave_.dirty_)
+  {
+    autosaveStart(&game);
+    autosaveFinish(&game);
+  }
+#ifdef MINESWEEPER_STATS
+  statsDump(&game);
+#endif
   deallocateFields(&game);
   return 0;
 }
@@ -460,9 +746,21 @@ int createGame(Game *game, int argc, char* argv[])
   game->mines_ = 10;
   game->seed_ = 0;
   game->running_ = true;
+  game->safe_area_ = false;
+  game->autosave_.path_[0] = '\0';
+  game->autosave_.last_ = time(NULL);
+  game->autosave_.dirty_ = false;
+  game->autosave_.in_flight_ = false;
+  atomic_init(&game->autosave_.done_, false);
   game->fields_no_mine_ = game->rows_ * game->cols_ - game->mines_;
   game->opened_fields_ = 0;
   game->remaining_flags_ = 0;
+  game->bbbv_ = 0;
+  game->openings_ = 0;
+  game->largest_opening_ = 0;
+#ifdef MINESWEEPER_STATS
+  memset(&game->stats_, 0, sizeof(Stats));
+#endif
   for(int index = 1; index < argc; index++)
   {
     if(strcmp(argv[index], "--size") ==0)
@@ -503,7 +801,7 @@ int createGame(Game *game, int argc, char* argv[])
       if(strcmp(argv[index], "--mines")==0)
       {
         game->mines_ = value;
-        if(game->mines_ < 0 || (unsigned long long)game->mines_ > UINT64_MAX - 1 || game->mines_ > game->rows_ * game->cols_-1)
+        if(game->mines_ < 0 || (unsigned long long)game->mines_ > UINT64_MAX - 1)
         {
           printf("Invalid value for argument!\n");
           return ERROR_INV_VAL;
@@ -520,12 +818,46 @@ int createGame(Game *game, int argc, char* argv[])
       }
       index++;
     }
+    else if(strcmp(argv[index], "--safe-area") == 0)
+    {
+      game->safe_area_ = true;
+    }
+    else if(strcmp(argv[index], "--autosave") == 0)
+    {
+      if(index + 1 >= argc || argv[index + 1][0] == '-')
+      {
+        printf("Invalid number of parameters given!\n");
+        return ERROR_INV_NUM_PARAM;
+      }
+      //room for the temporary file suffix
+      strncpy(game->autosave_.path_, argv[index + 1], ARGUMENT_SIZE - 5);
+      game->autosave_.path_[ARGUMENT_SIZE - 5] = '\0';
+      index++;
+    }
+#ifdef MINESWEEPER_STATS
+    else if(strcmp(argv[index], "--stats") == 0)
+    {
+      if(index + 1 >= argc || argv[index + 1][0] == '-')
+      {
+        printf("Invalid number of parameters given!\n");
+        return ERROR_INV_NUM_PARAM;
+      }
+      strncpy(game->stats_.path_, argv[index + 1], ARGUMENT_SIZE - 1);
+      index++;
+    }
+#endif
     else
     {
       printf("Unexpected argument provided!\n");
       return ERROR_UNEXP_ARG;
     }
   }
+  //checked after all arguments so --mines does not depend on being given after --size
+  if(game->mines_ > game->rows_ * game->cols_ - 1)
+  {
+    printf("Invalid value for argument!\n");
+    return ERROR_INV_VAL;
+  }
   srand(game->seed_);
   if(mapCreation(game) == MEMORY_ISSUE)
   {
@@ -537,8 +869,15 @@ int createGame(Game *game, int argc, char* argv[])
 //deallocates dynamically allocated fields
 void deallocateFields(Game *game)
 {
+  Autosave *autosave = &game->autosave_;
   for(long long row = 0; row < game->rows_;row++)
   {
+    //rows still read by the autosave thread are freed when it finishes
+    if(autosave->in_flight_ && row < autosave->rows_ && autosave->shared_[row])
+    {
+      autosave->shared_[row] = false;
+      continue;
+    }
     free(game->map_[row]);
   }
   free(game->map_);
@@ -700,58 +1039,62 @@ int readInput(Game *game, char *cmd,long long *row, long long *col, char *filena
 //prints current map
 void printMap(Game *game)
 {
-  printf("\n");
-  printf("  \033[31m¶\033[0m: %lld\n", game->remaining_flags_);
-  printf("  ");
+  STATS_SAMPLE(sample);
+  STATS_BEGIN(game, sample);
+  STATS_CELLS(game, game->rows_ * game->cols_);
+  STATS_PRINTF(game, "\n");
+  STATS_PRINTF(game, "  \033[31m¶\033[0m: %lld\n", game->remaining_flags_);
+  STATS_PRINTF(game, "  ");
   for(long long border = 0; border < game->cols_; border++)
   {
-    printf("=");
+    STATS_PRINTF(game, "=");
   }
-  printf(" \n");
+  STATS_PRINTF(game, " \n");
   for(long long row = 0; row < game->rows_; row++)
   {
-    printf(" |");
+    STATS_PRINTF(game, " |");
     for(long long col = 0; col < game->cols_; col++)
     {
       if(game->map_[row][col].flagged_ && game->map_[row][col].closed_)
       {
-        printf("\033[31m¶\033[0m");
+        STATS_PRINTF(game, "\033[31m¶\033[0m");
 //        printf("%c", 244);
       }
       else if(game->map_[row][col].closed_)
       {
-        printf("░");
+        STATS_PRINTF(game, "░");
       }
       else if(game->map_[row][col].mine_)
       {
         if(game->map_[row][col].mine_highlighted_)
         {
-          printf("\033[33m\033[41m@\033[0m"); //+ color
+          STATS_PRINTF(game, "\033[33m\033[41m@\033[0m"); //+ color
 //          printf("%c",64); //+ color
         }
         else
         {
-          printf("\033[33m@\033[0m"); //+ color
+          STATS_PRINTF(game, "\033[33m@\033[0m"); //+ color
 //          printf("%c",64); //+ color
         }
       }
       else if(game->map_[row][col].adj_mines_ > 0)
       {
-        printf("%d", game->map_[row][col].adj_mines_);
+        STATS_PRINTF(game, "%d", game->map_[row][col].adj_mines_);
       }
       else
       {
-        printf("·");
+        STATS_PRINTF(game, "·");
       }
     }
-    printf("|\n");
+    STATS_PRINTF(game, "|\n");
   }
-  printf("  ");
+  STATS_PRINTF(game, "  ");
   for(int border = 0; border < game->cols_; border++)
   {
-    printf("=");
+    STATS_PRINTF(game, "=");
   }
-  printf(" \n");
+  STATS_PRINTF(game, " \n");
+  STATS_END(game, STATS_PRINT_MAP, sample);
 }
 
 //creates a pseudorandom number
@@ -770,9 +1113,10 @@ void setAdjMines(Game *game)
   int direction_col[] = {-1, 0, 1, -1, 1, -1, 0, 1};
   for(long long row = 0; row < game->rows_; row++)
   {
+    Field *fields = writableRow(game, row);
     for(long long col = 0; col < game->cols_; col++)
     {
-      if(game->map_[row][col].mine_)
+      if(fields[col].mine_)
       {
         continue;
       }
@@ -784,7 +1128,7 @@ void setAdjMines(Game *game)
         {
           if(game->map_[new_x][new_y].mine_)
           {
-            game->map_[row][col].adj_mines_++;
+            fields[col].adj_mines_++;
           }
         }
       }
@@ -792,16 +1136,159 @@ void setAdjMines(Game *game)
   }
 }
 
+//finds the root of the opening a zero field belongs to; part of board metrics
+long long findOpening(long long *parent, long long field)
+{
+  while(parent[field] >= 0)
+  {
+    //path halving
+    if(parent[parent[field]] >= 0)
+    {
+      parent[field] = parent[parent[field]];
+    }
+    field = parent[field];
+  }
+  return field;
+}
+
+//joins the openings of two zero fields; part of board metrics
+void joinOpenings(long long *parent, long long field_1, long long field_2)
+{
+  long long root_1 = findOpening(parent, field_1);
+  long long root_2 = findOpening(parent, field_2);
+  if(root_1 == root_2)
+  {
+    return;
+  }
+  //union by size, the bigger opening becomes the root
+  if(parent[root_1] > parent[root_2])
+  {
+    long long temp = root_1;
+    root_1 = root_2;
+    root_2 = temp;
+  }
+  parent[root_1] += parent[root_2];
+  parent[root_2] = root_1;
+}
+
+//computes 3BV, number of openings and size of the largest opening with a union-find labeling of the board
+int computeBoardMetrics(Game *game)
+{
+  int direction_row[] = {-1, -1, -1, 0, 0, 1, 1, 1};
+  int direction_col[] = {-1, 0, 1, -1, 1, -1, 0, 1};
+  long long fields = game->rows_ * game->cols_;
+  long long *parent = malloc(fields * sizeof(long long));
+  if(parent == NULL)
+  {
+    return MEMORY_ISSUE;
+  }
+
+  //labeling: every zero field is joined with the zero fields already visited around it
+  for(long long row = 0; row < game->rows_; row++)
+  {
+    for(long long col = 0; col < game->cols_; col++)
+    {
+      Field *field = &game->map_[row][col];
+      if(field->mine_ || field->adj_mines_ != 0)
+      {
+        continue;
+      }
+      long long field_index = row * game->cols_ + col;
+      parent[field_index] = -1;
+      for(int direction = 0; direction < 4; direction++)
+      {
+        long long new_x = row + direction_row[direction];
+        long long new_y = col + direction_col[direction];
+        if(new_x >= 0 && new_x < game->rows_ && new_y >= 0 && new_y < game->cols_ &&
+           !game->map_[new_x][new_y].mine_ && game->map_[new_x][new_y].adj_mines_ == 0)
+        {
+          joinOpenings(parent, field_index, new_x * game->cols_ + new_y);
+        }
+      }
+    }
+  }
+
+  //numbered fields are added to every opening around them, the ones without an opening count as one click each
+  game->bbbv_ = 0;
+  game->openings_ = 0;
+  game->largest_opening_ = 0;
+  for(long long row = 0; row < game->rows_; row++)
+  {
+    for(long long col = 0; col < game->cols_; col++)
+    {
+      Field *field = &game->map_[row][col];
+      if(field->mine_)
+      {
+        continue;
+      }
+      long long field_index = row * game->cols_ + col;
+      if(field->adj_mines_ == 0)
+      {
+        if(parent[field_index] < 0)
+        {
+          game->openings_++;
+        }
+        continue;
+      }
+      long long roots[8];
+      int roots_count = 0;
+      for(int direction = 0; direction < 8; direction++)
+      {
+        long long new_x = row + direction_row[direction];
+        long long new_y = col + direction_col[direction];
+        if(new_x < 0 || new_x >= game->rows_ || new_y < 0 || new_y >= game->cols_ ||
+           game->map_[new_x][new_y].mine_ || game->map_[new_x][new_y].adj_mines_ != 0)
+        {
+          continue;
+        }
+        long long root = findOpening(parent, new_x * game->cols_ + new_y);
+        bool known = false;
+        for(int index = 0; index < roots_count; index++)
+        {
+          if(roots[index] == root)
+          {
+            known = true;
+            break;
+          }
+        }
+        if(!known)
+        {
+          roots[roots_count] = root;
+          roots_count++;
+          parent[root] -= 1;
+        }
+      }
+      if(roots_count == 0)
+      {
+        game->bbbv_++;
+      }
+    }
+  }
+  game->bbbv_ += game->openings_;
+
+  for(long long field_index = 0; field_index < fields; field_index++)
+  {
+    Field *field = &game->map_[field_index / game->cols_][field_index % game->cols_];
+    if(!field->mine_ && field->adj_mines_ == 0 && -parent[field_index] > game->largest_opening_)
+    {
+      game->largest_opening_ = -parent[field_index];
+    }
+  }
+  free(parent);
+  return CONTINUE;
+}
+
 //flags a field or removes flag if its flagged
 void flag(Game *game, long long row, long long col)
 {
+  STATS_CELLS(game, 1);
   if(!game->map_[row][col].flagged_)
   {
     if(game->remaining_flags_ == 0)
     {
       return;
     }
-    game->map_[row][col].flagged_ = true;
+    writableRow(game, row)[col].flagged_ = true;
     if(game->map_[row][col].closed_)
     {
       game->remaining_flags_ -= 1;
@@ -810,7 +1297,7 @@ void flag(Game *game, long long row, long long col)
   }
   else
   {
-    game->map_[row][col].flagged_ = false;
+    writableRow(game, row)[col].flagged_ = false;
     game->remaining_flags_ += 1;
   }
 }
@@ -820,15 +1307,16 @@ void loss(Game *game, long long row, long long col)
 {
   printf("\n=== You lost! ===\n");
   game->running_ = false;
-  game->map_[row][col].mine_highlighted_ = true;
+  writableRow(game, row)[col].mine_highlighted_ = true;
   for(long long row = 0; row < game->rows_; row++)
   {
+    Field *fields = writableRow(game, row);
     for(long long col = 0; col < game->cols_; col++)
     {
-      if(game->map_[row][col].mine_)
+      if(fields[col].mine_)
       {
-        game->map_[row][col].closed_ = false;
-        game->map_[row][col].flagged_ = false;
+        fields[col].closed_ = false;
+        fields[col].flagged_ = false;
       }
     }
   }
@@ -842,10 +1330,11 @@ void win(Game* game)
   game->running_ = false;
   for(long long row = 0; row < game->rows_; row++)
   {
+    Field *fields = writableRow(game, row);
     for(long long col = 0; col < game->cols_; col++)
     {
-      game->map_[row][col].flagged_ = false;
-      game->map_[row][col].closed_ = false;
+      fields[col].flagged_ = false;
+      fields[col].closed_ = false;
     }
   }
   printMap(game);
@@ -880,11 +1369,12 @@ void open(Game *game, long long row, long long col)
     return;
   }
 
+  STATS_CELLS(game, 1);
   if(game->map_[row][col].flagged_)
   {
     game->remaining_flags_ += 1;
   }
-  game->map_[row][col].closed_ = false;
+  writableRow(game, row)[col].closed_ = false;
   game->opened_fields_++;
 
   if(game->opened_fields_ == game->fields_no_mine_)
@@ -905,47 +1395,104 @@ void open(Game *game, long long row, long long col)
   }
 }
 
+//sets random fields outside of the safe area to the given mine state until count fields were changed
+void placeRandomFields(Game *game, long long count, bool mine, long long safe_top, long long safe_left,
+                       long long safe_bottom, long long safe_right)
+{
+  long long fields = game->rows_ * game->cols_;
+  while(count > 0)
+  {
+    long long field_index = generate_64bit_random_number() % fields;
+    long long row = field_index / game->cols_;
+    long long col = field_index % game->cols_;
+    if(row >= safe_top && row <= safe_bottom && col >= safe_left && col <= safe_right)
+    {
+      continue;
+    }
+    if(game->map_[row][col].mine_ == mine)
+    {
+      continue;
+    }
+    writableRow(game, row)[col].mine_ = mine;
+    count--;
+  }
+}
+
 //generates map and opens one field
-void mapGeneration(Game *game, long long start_row, long long start_col)
+int mapGeneration(Game *game, long long start_row, long long start_col)
 {
-  long long fields_left = game->rows_ * game->cols_ - 1;
-  long long mines_left = game->mines_;
   game->remaining_flags_ = game->mines_;
   game->opened_fields_ = 0;
+  STATS_CELLS(game, game->rows_ * game->cols_);
+
+  //the start field, and with --safe-area also its neighbours, never contain a mine
+  long long fields = game->rows_ * game->cols_;
+  long long radius = game->safe_area_ ? 1 : 0;
+  long long safe_top;
+  long long safe_left;
+  long long safe_bottom;
+  long long safe_right;
+  long long safe_fields;
+  while(true)
+  {
+    safe_top = start_row - radius < 0 ? 0 : start_row - radius;
+    safe_left = start_col - radius < 0 ? 0 : start_col - radius;
+    safe_bottom = start_row + radius >= game->rows_ ? game->rows_ - 1 : start_row + radius;
+    safe_right = start_col + radius >= game->cols_ ? game->cols_ - 1 : start_col + radius;
+    safe_fields = 0;
+    if(safe_bottom >= safe_top && safe_right >= safe_left)
+    {
+      safe_fields = (safe_bottom - safe_top + 1) * (safe_right - safe_left + 1);
+    }
+    if(radius == 0 || fields - safe_fields >= game->mines_)
+    {
+      break;
+    }
+    //not enough room for the mines around a safe area, only the start field stays safe
+    radius = 0;
+  }
+
+  //sparse maps place the mines, dense maps start full and place the fields without mine
+  long long free_fields = fields - safe_fields;
+  bool dense = game->mines_ > free_fields / 2;
   for(long long row = 0; row < game->rows_; row++)
   {
+    Field *fields = writableRow(game, row);
     for(long long col = 0; col < game->cols_; col++)
     {
-      game->map_[row][col].flagged_ = false;
-      game->map_[row][col].mine_ = false;
-      game->map_[row][col].closed_ = true;
-      game->map_[row][col].adj_mines_ = 0;
-      if(row == start_row && col == start_col)
-      {
-        game->map_[row][col].mine_ = false;
-        continue;
-      }
-      long long random_number = generate_64bit_random_number() % fields_left;
-      if(random_number < mines_left)
-      {
-        game->map_[row][col].mine_ = true;
-        mines_left -= 1;
-      }
-      fields_left -= 1;
+      bool safe = row >= safe_top && row <= safe_bottom && col >= safe_left && col <= safe_right;
+      fields[col].flagged_ = false;
+      fields[col].mine_ = dense && !safe;
+      fields[col].closed_ = true;
+      fields[col].adj_mines_ = 0;
     }
   }
+  if(dense)
+  {
+    placeRandomFields(game, free_fields - game->mines_, false, safe_top, safe_left, safe_bottom, safe_right);
+  }
+  else
+  {
+    placeRandomFields(game, game->mines_, true, safe_top, safe_left, safe_bottom, safe_right);
+  }
+
   setAdjMines(game);
+  if(computeBoardMetrics(game) == MEMORY_ISSUE)
+  {
+    return MEMORY_ISSUE;
+  }
   open(game, start_row, start_col);
+  return CONTINUE;
 }
 
 //starts game and opens one field
-void startGame(Game *game, long long start_row, long long start_col)
+int startGame(Game *game, long long start_row, long long start_col)
 {
   game->fields_no_mine_ = game->rows_ * game->cols_ - game->mines_;
-  mapGeneration(game, start_row, start_col);
+  return mapGeneration(game, start_row, start_col);
 }
 
-//prints opened map
+//prints opened map and the difficulty metrics of the board
 void dump(Game *game)
 {
   printf("\n");
@@ -984,30 +1531,23 @@ void dump(Game *game)
     printf("=");
   }
   printf(" \n");
+  printf("  3BV: %lld, openings: %lld, largest opening: %lld\n", game->bbbv_, game->openings_,
+         game->largest_opening_);
 }
 
-//saves game
-void save(Game *game, char *path)
+//writes the map in the save file format
+bool writeSaveData(FILE *file, Field **map, long long rows, long long cols)
 {
-  FILE *file = fopen(path,"wb");
-  if(file == NULL)
-  {
-    printf("Error: Failed to open file!\n");
-    return;
-  }
-  fwrite("ESP\0",1,4,file);
-  fwrite(&game->rows_,sizeof(long long), 1, file);
-  fwrite(&game->cols_,sizeof(long long), 1, file);
+  bool written = fwrite("ESP\0",1,4,file) == 4;
+  written = fwrite(&rows,sizeof(long long), 1, file) == 1 && written;
+  written = fwrite(&cols,sizeof(long long), 1, file) == 1 && written;
 
-  long long fields = game->rows_ * game->cols_;
+  long long fields = rows * cols;
   long long blocks = (fields + 7) / 8;
 
   for(long long block = 0; block < blocks; block++)
   {
-    uint8_t valid_bits = 0;
-    uint8_t mine_bits = 0;
-    uint8_t opened_bits = 0;
-    uint8_t flagged_bits = 0;
+    uint8_t bits[4] = {0, 0, 0, 0};
 
     for(int bit = 0; bit < 8; bit++)
     {
@@ -1016,34 +1556,161 @@ void save(Game *game, char *path)
       {
         break;
       }
-      Field *field = &game->map_[field_index / game->cols_][field_index % game->cols_];
+      Field *field = &map[field_index / cols][field_index % cols];
 
-      valid_bits |= (1 << bit);
+      //valid, mine, opened and flagged bits
+      bits[0] |= (1 << bit);
 
       if(field->mine_)
       {
-        mine_bits |= (1 << bit);
+        bits[1] |= (1 << bit);
       }
 
       if(!field->closed_)
       {
-        opened_bits |= (1 << bit);
+        bits[2] |= (1 << bit);
       }
 
       if(field->flagged_)
       {
-        flagged_bits |= (1 << bit);
+        bits[3] |= (1 << bit);
       }
     }
-    fwrite(&valid_bits, 1, 1, file);
-    fwrite(&mine_bits, 1, 1, file);
-    fwrite(&opened_bits, 1, 1, file);
-    fwrite(&flagged_bits, 1, 1, file);
+    written = fwrite(bits, 1, 4, file) == 4 && written;
+  }
+  return written;
+}
+
+//saves game
+void save(Game *game, char *path)
+{
+  FILE *file = fopen(path,"wb");
+  if(file == NULL)
+  {
+    printf("Error: Failed to open file!\n");
+    return;
   }
+  writeSaveData(file, game->map_, game->rows_, game->cols_);
+  STATS_CELLS(game, game->rows_ * game->cols_);
+  STATS_BYTES(game, 4 + 2 * sizeof(long long) + 4 * ((game->rows_ * game->cols_ + 7) / 8));
   fclose(file);
   printMap(game);
 }
 
+//returns a row of the map that can be changed; copies the row first if the autosave thread still reads it
+Field *writableRow(Game *game, long long row)
+{
+  Autosave *autosave = &game->autosave_;
+  if(autosave->in_flight_ && row < autosave->rows_ && autosave->shared_[row])
+  {
+    Field *copy = malloc(game->cols_ * sizeof(Field));
+    if(copy == NULL)
+    {
+      //no memory for a copy, waiting for the thread makes the row private again
+      autosaveFinish(game);
+      return game->map_[row];
+    }
+    memcpy(copy, game->map_[row], game->cols_ * sizeof(Field));
+    game->map_[row] = copy;
+    autosave->shared_[row] = false;
+  }
+  return game->map_[row];
+}
+
+//writes the autosave snapshot into a temporary file and renames it over the autosave file; autosave thread
+void *autosaveThread(void *autosave)
+{
+  Autosave *snapshot = autosave;
+  char temp_path[ARGUMENT_SIZE + 5];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", snapshot->path_);
+  FILE *file = fopen(temp_path, "wb");
+  if(file != NULL)
+  {
+    bool written = writeSaveData(file, snapshot->map_, snapshot->rows_, snapshot->cols_);
+    written = fflush(file) == 0 && written;
+    written = fsync(fileno(file)) == 0 && written;
+    written = fclose(file) == 0 && written;
+    if(written)
+    {
+      rename(temp_path, snapshot->path_);
+    }
+    else
+    {
+      remove(temp_path);
+    }
+  }
+  atomic_store(&snapshot->done_, true);
+  return NULL;
+}
+
+//takes a snapshot of the map by sharing its rows and starts the autosave thread
+void autosaveStart(Game *game)
+{
+  Autosave *autosave = &game->autosave_;
+  if(autosave->path_[0] == '\0' || autosave->in_flight_)
+  {
+    return;
+  }
+  autosave->map_ = malloc(game->rows_ * sizeof(Field*));
+  autosave->shared_ = malloc(game->rows_ * sizeof(bool));
+  if(autosave->map_ == NULL || autosave->shared_ == NULL)
+  {
+    //autosave is skipped and tried again after the next command
+    free(autosave->map_);
+    free(autosave->shared_);
+    return;
+  }
+  memcpy(autosave->map_, game->map_, game->rows_ * sizeof(Field*));
+  memset(autosave->shared_, true, game->rows_ * sizeof(bool));
+  autosave->rows_ = game->rows_;
+  autosave->cols_ = game->cols_;
+  atomic_store(&autosave->done_, false);
+  if(pthread_create(&autosave->thread_, NULL, autosaveThread, autosave) != 0)
+  {
+    free(autosave->map_);
+    free(autosave->shared_);
+    return;
+  }
+  autosave->in_flight_ = true;
+  autosave->dirty_ = false;
+  autosave->last_ = time(NULL);
+}
+
+//waits for the autosave thread and frees the rows only the snapshot still uses
+void autosaveFinish(Game *game)
+{
+  Autosave *autosave = &game->autosave_;
+  if(!autosave->in_flight_)
+  {
+    return;
+  }
+  pthread_join(autosave->thread_, NULL);
+  for(long long row = 0; row < autosave->rows_; row++)
+  {
+    if(!autosave->shared_[row])
+    {
+      free(autosave->map_[row]);
+    }
+  }
+  free(autosave->map_);
+  free(autosave->shared_);
+  autosave->in_flight_ = false;
+}
+
+//cleans up a finished autosave and starts a new one if the game changed and the interval has passed
+void autosavePoll(Game *game)
+{
+  Autosave *autosave = &game->autosave_;
+  if(autosave->in_flight_ && atomic_load(&autosave->done_))
+  {
+    autosaveFinish(game);
+  }
+  if(autosave->dirty_ && !autosave->in_flight_ && time(NULL) - autosave->last_ >= AUTOSAVE_INTERVAL)
+  {
+    autosaveStart(game);
+  }
+}
+
 //counts how many mines are on the field
 long long countMines(Game* game)
 {
@@ -1161,12 +1828,19 @@ int load(Game *game, char *path)
       }
     }
   }
+  STATS_CELLS(game, fields);
   setAdjMines(game);
+  if(computeBoardMetrics(game) == MEMORY_ISSUE)
+  {
+    fclose(file);
+    return MEMORY_ISSUE;
+  }
   game->mines_ = countMines(game);
   game->remaining_flags_ = game->mines_ - countFlags(game);
   game->fields_no_mine_ = game->rows_ * game->cols_ - game->mines_;
   game->opened_fields_ = countOpenedFields(game);
   fclose(file);
+  game->autosave_.dirty_ = true;
   printMap(game);
   return CONTINUE;
 }
@@ -1183,25 +1857,39 @@ int execute(Game *game)
     return CONTINUE;
   }
 
+  STATS_SAMPLE(sample);
+  STATS_BEGIN(game, sample);
   if(strcmp(cmd, "start")==0)
   {
-    startGame(game, row, col);
+    if(startGame(game, row, col) == MEMORY_ISSUE)
+    {
+      return MEMORY_ISSUE;
+    }
+    game->autosave_.dirty_ = true;
     printMap(game);
+    STATS_END(game, STATS_START, sample);
   }
 
+  //only a command which changed the map makes the autosave due
   if(strcmp(cmd,"open")==0)
   {
+    long long opened_fields = game->opened_fields_;
     open(game, row, col);
+    game->autosave_.dirty_ |= game->opened_fields_ != opened_fields;
     if(game->running_)
     {
       printMap(game);
     }
+    STATS_END(game, STATS_OPEN, sample);
   }
 
   if(strcmp(cmd,"flag")==0)
   {
+    bool flagged = game->map_[row][col].flagged_;
     flag(game, row, col);
+    game->autosave_.dirty_ |= game->map_[row][col].flagged_ != flagged;
     printMap(game);
+    STATS_END(game, STATS_FLAG, sample);
   }
 
   if(strcmp(cmd,"dump")==0)
@@ -1213,6 +1901,7 @@ int execute(Game *game)
   if(strcmp(cmd,"save")==0)
   {
     save(game, filename);
+    STATS_END(game, STATS_SAVE, sample);
   }
 
   if(strcmp(cmd,"load")==0)
@@ -1221,6 +1910,7 @@ int execute(Game *game)
     {
       return MEMORY_ISSUE;
     }
+    STATS_END(game, STATS_LOAD, sample);
   }
 
   if(strcmp(cmd, "quit")==0)
@@ -1230,3 +1920,116 @@ int execute(Game *game)
   }
   return CONTINUE;
 }
+
+#ifdef MINESWEEPER_STATS
+//starts measuring a command
+void statsBegin(Game *game, StatsSample *sample)
+{
+  sample->cells_ = game->stats_.cells_;
+  sample->bytes_ = game->stats_.bytes_;
+  clock_gettime(CLOCK_MONOTONIC, &sample->start_);
+}
+
+//finishes measuring a command and records time, cells touched and bytes written
+void statsEnd(Game *game, int command, StatsSample *sample)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long long ns = (end.tv_sec - sample->start_.tv_sec) * 1000000000LL + (end.tv_nsec - sample->start_.tv_nsec);
+  CommandStats *stats = &game->stats_.commands_[command];
+  if(stats->count_ == 0 || ns < stats->min_ns_)
+  {
+    stats->min_ns_ = ns;
+  }
+  if(ns > stats->max_ns_)
+  {
+    stats->max_ns_ = ns;
+  }
+  stats->count_++;
+  stats->total_ns_ += ns;
+  stats->cells_ += game->stats_.cells_ - sample->cells_;
+  stats->bytes_ += game->stats_.bytes_ - sample->bytes_;
+  stats->histogram_[statsBucket(ns)]++;
+}
+
+//returns the histogram bucket of a latency, buckets are exact up to 8 ns and have 3 bits of precision above
+int statsBucket(long long ns)
+{
+  if(ns < STATS_SUB_BUCKETS)
+  {
+    return ns < 0 ? 0 : (int)ns;
+  }
+  int highest_bit = 0;
+  while((ns >> (highest_bit + 1)) != 0)
+  {
+    highest_bit++;
+  }
+  int shift = highest_bit - STATS_SUB_BITS;
+  return (shift + 1) * STATS_SUB_BUCKETS + (int)((ns >> shift) - STATS_SUB_BUCKETS);
+}
+
+//returns the lowest latency of a histogram bucket
+long long statsBucketValue(int bucket)
+{
+  if(bucket < STATS_SUB_BUCKETS)
+  {
+    return bucket;
+  }
+  int shift = bucket / STATS_SUB_BUCKETS - 1;
+  return (long long)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS) << shift;
+}
+
+//returns a percentile of the latency histogram of a command
+long long statsPercentile(CommandStats *stats, double percentile)
+{
+  long long wanted = (long long)(stats->count_ * percentile / 100.0 + 0.5);
+  if(wanted < 1)
+  {
+    wanted = 1;
+  }
+  long long seen = 0;
+  for(int bucket = 0; bucket < STATS_BUCKETS; bucket++)
+  {
+    seen += stats->histogram_[bucket];
+    if(seen >= wanted)
+    {
+      return statsBucketValue(bucket);
+    }
+  }
+  return stats->max_ns_;
+}
+
+//prints the statistics of all commands to the stats file or to stdout if no file was given
+void statsDump(Game *game)
+{
+  const char *names[STATS_COMMANDS] = {"start", "open", "flag", "save", "load", "printMap"};
+  FILE *file = stdout;
+  if(game->stats_.path_[0] != '\0')
+  {
+    file = fopen(game->stats_.path_, "w");
+    if(file == NULL)
+    {
+      printf("Error: Failed to open file!\n");
+      return;
+    }
+  }
+  fprintf(file, "%-9s %8s %10s %10s %10s %10s %10s %12s %12s\n", "command", "count", "mean(us)", "p50(us)",
+          "p90(us)", "p99(us)", "max(us)", "cells", "bytes");
+  for(int command = 0; command < STATS_COMMANDS; command++)
+  {
+    CommandStats *stats = &game->stats_.commands_[command];
+    if(stats->count_ == 0)
+    {
+      continue;
+    }
+    fprintf(file, "%-9s %8lld %10.1f %10.1f %10.1f %10.1f %10.1f %12lld %12lld\n", names[command], stats->count_,
+            stats->total_ns_ / 1000.0 / stats->count_, statsPercentile(stats, 50) / 1000.0,
+            statsPercentile(stats, 90) / 1000.0, statsPercentile(stats, 99) / 1000.0, stats->max_ns_ / 1000.0,
+            stats->cells_, stats->bytes_);
+  }
+  if(file != stdout)
+  {
+    fclose(file);
+  }
+}
+#endif
@@ -1,14 +1,83 @@
 //---------------------------------------------------------------------------------------------------------------------
-// Card game "Entertaining Spice Pretending" for two players.
+// Card game "Entertaining Spice Pretending" for two to eight players.
 // This game is inspired by the card game Spicy. This game is played in multiple rounds.
 // Rounds consist of of players taking turns, playing cards from their hand face down and saying what it shows.
-// The other player then tells if the first lied or not.
+// The next player in the ring then tells if the previous one lied or not.
+//
+// The rules are kept in a headless engine (Game, Action, doAction(), runGame()) without any input or output.
+// Players are agents with a decide callback; the command line game is one human agent per player plus a console
+// spectator printing what happens, so bots can play against each other or against humans through the same rules.
+//
+// With --tournament the config is loaded once and bot strategies play each other on a pool of threads sharing the
+// read-only deck, every game with its own shuffled copy of the cards.
+//
+// With --serve many tables are played by clients over a local socket, all on one thread with an epoll event loop.
 //---------------------------------------------------------------------------------------------------------------------
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+#define NO_CARD -1
+#define SPICE_COUNT 3
+#define SPICES "cpw"
+#define MAX_VALUE 10
+// one sort key per (spice, value) pair, the loaders only accept known spices and values
+#define CARD_KEYS (SPICE_COUNT * MAX_VALUE)
+// binary deck: magic, card count and checksum as 32 bit little endian, then one byte (spice << 4 | value) per card
+#define BINARY_MAGIC "ESPB"
+#define BINARY_HEADER 12
+// optional trailer of a binary deck behind the cards: "RULE", then one byte per rule
+#define BINARY_RULES 10
+#define SNAPSHOT_MAGIC "ESPS"
+#define REPLAY_MAGIC "ESPR"
+// card of a replay entry without a card, and type of the entry with the final scores
+#define REPLAY_NO_CARD 0xFF
+#define REPLAY_END 0xFF
+// records of the results log kept in memory before they are written
+#define LOG_BUFFER 4096
+#define USAGE "Usage: ./a4-csf <config file> [--tournament games] [--threads x] [--seed x] [--threshold x] " \
+              "[--bluff percent] [--budget microseconds] [--iterations x] [--think milliseconds] " \
+              "[--strategies list] [--bot strategy] [--players x] [--log file] [--convert file] [--shuffle] " \
+              "[--generate cards] [--force] [--spices weights] [--values weights] [--record file] [--replay file] " \
+              "[--serve socket] [--tables x]\n" \
+              "       ./a4-csf --query <log file>\n"
+#define MAX_PLAYERS 8
+#define MAX_TABLES 4096
+#define SERVER_EVENTS 64
+#define CLIENT_LINE 256
+// a pairing has two sides: player 1 and all other players
+#define SIDES 2
+#define STRATEGY_COUNT 5
+// moves the search player tells apart: one play per card key, draw and both challenges
+#define MAX_MOVES (CARD_KEYS + 3)
+#define MAX_LEGAL_MOVES (CARD_KEYS * MAX_VALUE * SPICE_COUNT + 3)
+// exploration constant of the UCB1 selection of the search tree
+#define EXPLORATION 0.7
+// percent of random moves in the playouts, the other moves are honest plays, draws and forced challenges
+#define PLAYOUT_RANDOM 10
+// cards the counting bot can track, cards of bigger decks past this count as never seen
+#define COUNTING_CARDS 1024
+// chance the counting bot assumes an opponent without an honest card lies instead of drawing
+#define BLUFF_PRIOR 0.5
+// games a tournament thread takes from the shared counter at once
+#define TOURNAMENT_CHUNK 256
 
 typedef enum _ReturnCode_
 {
@@ -18,1073 +87,5329 @@ typedef enum _ReturnCode_
   INVALID_FILE = 3,
   OUT_OF_MEMORY = 4,
   ALRIGHT = 5,
-  CHALLENGE = 6
+  CHALLENGE = 6,
+  NOT_ALLOWED = 7,
+  NOT_IN_HAND = 8,
+  INVALID_VALUE = 9,
+  INVALID_SPICE = 10,
+  INVALID_ACTION = 11,
+  LOADED = 12
 } Return_code;
 
+typedef enum _ActionType_
+{
+  ACTION_PLAY = 0,
+  ACTION_CHALLENGE_VALUE = 1,
+  ACTION_CHALLENGE_SPICE = 2,
+  ACTION_DRAW = 3
+} Action_type;
+
+typedef enum _EventType_
+{
+  EVENT_ROUND_START = 0,
+  EVENT_ACTION = 1,
+  EVENT_LOADED = 2
+} Event_type;
+
+// All cards of the deck live in one array (the card pool). Stacks are doubly linked lists through the pool,
+// so cards are moved between stacks by their index without walking or allocating anything.
 typedef struct _Card_
 {
   int value_;
   char spice_;
-  struct _Card_ *next_;
-
+  int next_;
+  int previous_;
 } Card;
 
+typedef struct _Stack_
+{
+  int first_;
+  int last_;
+  int count_;
+} Stack;
+
+// cards of a sorted hand per card key: how many there are and the first of them, the others follow it
+typedef struct _HandIndex_
+{
+  int count_[CARD_KEYS];
+  int first_[CARD_KEYS];
+} Hand_index;
+
 typedef struct _Player_
 {
   int id_;
   int points_;
-  Card *hand_;
+  Stack hand_;
+  Hand_index index_;
   bool draw_last_turn;
-  bool round_loser;
 } Player;
 
+// rule parameters of the config header; spices_ has bit i set if SPICES[i] is in play
+typedef struct _Rules_
+{
+  int hand_size_;
+  int penalty_;
+  int bonus_;
+  int wrap_value_;
+  int restart_highest_;
+  int spices_;
+} Rules;
+
+// cards of the config file in their order, never changed while games are played
+typedef struct _Deck_
+{
+  int count_;
+  Card *cards_;
+  Rules rules_;
+} Deck;
+
+// complete state of a game in one allocation, the card pool is stored at the end, so a game is copied with one
+// memcpy of gameSize() bytes, the allocation is zeroed so that hashing the bytes does not depend on padding;
+// the rules come first, so the rule checks read them from the same cache lines as the turn state
+typedef struct _Game_
+{
+  Rules rules_;
+  Stack stack_;
+  Stack discard_;
+  Stack latest_played_;
+  Player players_[MAX_PLAYERS];
+  int player_count_;
+  int current_;
+  int said_value_;
+  char said_spice_;
+  bool last_card_;
+  int played_;
+  bool finished_;
+  int card_count_;
+  Card cards_[];
+} Game;
+
+// header of a saved game, followed by the bytes of the game, only loaded by builds with the same layout
+typedef struct _SnapshotHeader_
+{
+  char magic_[4];
+  uint32_t game_size_;
+  uint32_t card_size_;
+  uint32_t card_count_;
+  uint64_t hash_;
+} Snapshot_header;
+
+// card is the played card for a play and the challenged card for a challenge
+typedef struct _Action_
+{
+  Action_type type_;
+  int card_;
+  int said_value_;
+  char said_spice_;
+} Action;
+
+// what happened in the game, challenge fields are only set for challenges
+typedef struct _Event_
+{
+  Event_type type_;
+  int player_;
+  Action action_;
+  bool successful_;
+  int winner_;
+  int points_;
+  bool bonus_;
+} Event;
+
+// a player or spectator of the game; decide returns ALRIGHT with a valid action, QUIT, OUT_OF_MEMORY or LOADED
+// after it replaced the game with a saved one
+typedef struct _Agent_
+{
+  int (*decide_)(const Game *game, int player, Action *action, void *context);
+  void (*observe_)(const Game *game, const Event *event, void *context);
+  void *context_;
+} Agent;
+
+// part of the input line, not terminated
+typedef struct _Slice_
+{
+  char *start_;
+  int length_;
+} Slice;
+
+// input of the human players, the line buffer is reused for every line of the game
+typedef struct _Console_
+{
+  Game *game_;
+  char *line_;
+  size_t capacity_;
+} Console;
+
+typedef enum _Command_
+{
+  COMMAND_INVALID = 0,
+  COMMAND_QUIT = 1,
+  COMMAND_PLAY = 2,
+  COMMAND_CHALLENGE = 3,
+  COMMAND_DRAW = 4,
+  COMMAND_SAVE = 5,
+  COMMAND_LOAD = 6,
+  COMMAND_HINT = 7,
+  COMMAND_JOIN = 8
+} Command;
+
+typedef enum _LogType_
+{
+  LOG_START = 0,
+  LOG_MOVE = 1,
+  LOG_END = 2
+} Log_type;
+
+// one fixed size record of the results log, the file is a plain array of them in the byte order of the machine,
+// agents are 0 for a human and 1 + the strategy kind for a bot, for player 1 and for all other players
+typedef struct _LogRecord_
+{
+  uint64_t match_;
+  uint32_t sequence_;
+  uint8_t type_;
+  // move: index of the player; end: number of players
+  uint8_t player_;
+  uint8_t action_;
+  // move: bit 0 for a successful challenge, bit 1 for a last card bonus; end: winning side or SIDES for a tie
+  uint8_t result_;
+  uint8_t said_value_;
+  char said_spice_;
+  // real card of a play or the challenged card
+  uint8_t card_value_;
+  char card_spice_;
+  uint8_t agents_[SIDES];
+  uint16_t rounds_;
+  // start: card and player count; challenge: points of the stack and index of the winner;
+  // end: points of player 1 and sum of the points of the other players
+  int32_t points_[SIDES];
+} Log_record;
+
+// buffered writer of the results log, a shared lock keeps the records of one flush together
+typedef struct _Log_
+{
+  int file_;
+  pthread_mutex_t *lock_;
+  Log_record *buffer_;
+  int count_;
+  bool failed_;
+} Log;
+
+// spectator writing the moves of one match into the log
+typedef struct _Logger_
+{
+  Log *log_;
+  uint64_t match_;
+  uint32_t sequence_;
+  uint8_t agents_[SIDES];
+  int rounds_;
+} Logger;
+
+// replay file: header, then entry_count_ entries in the byte order of the machine
+typedef struct _ReplayHeader_
+{
+  char magic_[4];
+  // checksum of the config as in the header of a binary deck
+  uint32_t deck_checksum_;
+  uint32_t card_count_;
+  uint32_t entry_count_;
+  uint64_t seed_;
+  uint8_t shuffled_;
+  uint8_t players_;
+  uint8_t finished_;
+  uint8_t padding_[5];
+} Replay_header;
+
+// one action of a replay, cards by their key, a challenge and the end of the game also carry the checksum of all
+// scores after them
+typedef struct _ReplayEntry_
+{
+  uint8_t type_;
+  uint8_t card_;
+  uint8_t said_value_;
+  uint8_t said_spice_;
+  uint32_t scores_;
+} Replay_entry;
+
+// spectator recording the actions of a console game
+typedef struct _Recorder_
+{
+  Replay_entry *entries_;
+  int count_;
+  int capacity_;
+  bool loaded_;
+  bool failed_;
+} Recorder;
+
+// A table of the server. Its game is one block and only the player on turn may change it, so the messages of a
+// table are handled in the order they arrive and no table needs a lock.
+typedef struct _Table_
+{
+  Game *game_;
+  int seats_[MAX_PLAYERS];
+  int seated_;
+  bool playing_;
+} Table;
+
+// connection of the server, indexed by its socket; the line buffer holds a line until its end has arrived
+typedef struct _Client_
+{
+  bool open_;
+  int table_;
+  int seat_;
+  int length_;
+  char line_[CLIENT_LINE];
+} Client;
+
+typedef struct _Server_
+{
+  const Deck *deck_;
+  int players_;
+  bool shuffle_;
+  uint64_t random_;
+  Table *tables_;
+  int table_count_;
+  Client *clients_;
+  int client_capacity_;
+  int listener_;
+  int epoll_;
+  char *reply_;
+  size_t reply_size_;
+} Server;
+
+typedef enum _StrategyKind_
+{
+  STRATEGY_BELIEVE = 0,
+  STRATEGY_THRESHOLD = 1,
+  STRATEGY_BLUFF = 2,
+  STRATEGY_COUNTING = 3,
+  STRATEGY_MCTS = 4
+} Strategy_kind;
+
+// bot strategy: believe never challenges unless it has to, threshold challenges the value when the said value
+// jumped by at least threshold, bluff challenges like threshold and lies with bluff_percent instead of drawing,
+// counting keeps track of the seen cards and challenges and bluffs by the probability of a lie,
+// mcts searches the moves with information set Monte Carlo tree search on threads searching their own trees
+typedef struct _Strategy_
+{
+  Strategy_kind kind_;
+  const char *name_;
+  int threshold_;
+  int bluff_percent_;
+  long budget_ns_;
+  int iterations_;
+  int threads_;
+} Strategy;
+
+// node of a search tree, the children of a node are linked through next_sibling
+typedef struct _Node_
+{
+  int move_;
+  int player_;
+  int first_child_;
+  int next_sibling_;
+  int visits_;
+  int available_;
+  double wins_;
+} Node;
+
+struct _Bot_;
+
+// one search thread of the mcts player, all buffers are allocated once per game and reused for every move
+typedef struct _Search_
+{
+  pthread_t thread_;
+  const struct _Bot_ *bot_;
+  const Game *game_;
+  Game *simulation_;
+  size_t game_size_;
+  Node *nodes_;
+  int node_count_;
+  int node_capacity_;
+  int *path_;
+  int *hidden_;
+  uint64_t random_;
+  int iterations_;
+  double lie_;
+  struct timespec deadline_;
+} Search;
+
+// state of one bot in one game, seen is a bitset over the card pool and unseen counts the cards per card key
+// which the bot has neither had in its hand nor seen revealed by a challenge
+typedef struct _Bot_
+{
+  const Strategy *strategy_;
+  int player_;
+  uint64_t random_;
+  int previous_said_;
+  int last_said_;
+  bool counting_;
+  uint64_t seen_[COUNTING_CARDS / 64];
+  int unseen_[CARD_KEYS];
+  int unseen_count_;
+  Search *searches_;
+} Bot;
+
+// results of all games of one pairing, index 0 is the strategy playing as player 1, index 1 the strategy of all
+// other players, whose points are summed over their seats
+typedef struct _Tally_
+{
+  long long games_;
+  long long errors_;
+  long long ties_;
+  long long seats_;
+  long long wins_[SIDES];
+  long long points_[SIDES];
+  long long rounds_;
+  long long challenges_[SIDES];
+  long long successful_[SIDES];
+} Tally;
+
+typedef struct _Options_
+{
+  long long tournament_games_;
+  int threads_;
+  uint64_t seed_;
+  bool seeded_;
+  bool shuffle_;
+  int threshold_;
+  int bluff_percent_;
+  long budget_ns_;
+  int iterations_;
+  long think_ns_;
+  int players_;
+  const char *log_;
+  int strategies_[STRATEGY_COUNT];
+  int strategy_count_;
+  const char *convert_;
+  const char *record_;
+  const char *replay_;
+  const char *serve_;
+  int tables_;
+  const char *bot_;
+  int generate_;
+  bool force_;
+  int spice_weights_[SPICE_COUNT];
+  int value_weights_[MAX_VALUE];
+} Options;
+
+// shared by all tournament threads, only next_game_ is written while games are played
+typedef struct _Tournament_
+{
+  const Deck *deck_;
+  Strategy strategies_[STRATEGY_COUNT];
+  const int *chosen_;
+  int chosen_count_;
+  long long games_;
+  uint64_t seed_;
+  int players_;
+  atomic_llong next_game_;
+  int log_file_;
+  pthread_mutex_t log_lock_;
+} Tournament;
+
+typedef struct _Worker_
+{
+  pthread_t thread_;
+  Tournament *tournament_;
+  Tally tallies_[STRATEGY_COUNT * STRATEGY_COUNT];
+  int status_;
+} Worker;
+
+//---------------------------------------------------------------------------------------------------------------------
+/// initializes an empty stack
+///
+/// @param stack stack to initialize
+/// @return no return
+void initStack(Stack *stack);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// inserts a card of the pool at the end of a stack
+///
+/// @param cards card pool
+/// @param stack stack of cards
+/// @param card index of the card to insert
+/// @return no return
+void insertCardEnd(Card *cards, Stack *stack, int card);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// inserts a card of the pool in front of another card of a stack, or at the end if before is NO_CARD
+///
+/// @param cards card pool
+/// @param stack stack of cards
+/// @param card index of the card to insert
+/// @param before index of the card to insert in front of
+/// @return no return
+void insertCardBefore(Card *cards, Stack *stack, int card, int before);
+
 //---------------------------------------------------------------------------------------------------------------------
-/// inserts a card at the end of a given linked list and returns the newly made linked list
+/// removes a card from a stack
 ///
+/// @param cards card pool
 /// @param stack stack of cards
-/// @param value value of a card to insert
-/// @param spice spice of a card to insert
-/// @return linked list with a new card at the end
-Card *insertCardEnd(Card *stack, int value, char spice);
+/// @param card index of the card to remove
+/// @return no return
+void removeCard(Card *cards, Stack *stack, int card);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// sets the rules of the original game: hands of 6, 2 penalty cards, 10 bonus points, after a 10 the values start
+/// again from 1 to 3, spices c, p and w
+///
+/// @param rules rules to set
+/// @return no return
+void initRules(Rules *rules);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks that all rules are within their limits and the values said after a restart do not pass the wrap value
+///
+/// @param rules rules
+/// @return true or false
+bool checkRules(const Rules *rules);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// parses the settings behind the magic number of a text config, space separated KEY=VALUE pairs with the keys
+/// hand, penalty, bonus, wrap, restart and spices (for example spices=cw)
+///
+/// @param text settings
+/// @param length length of the settings
+/// @param rules rules to change
+/// @return true if all settings are valid
+bool parseRules(const char *text, size_t length, Rules *rules);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// packs the rules into the trailer of a binary deck
+///
+/// @param rules rules
+/// @param bytes BINARY_RULES bytes to fill
+/// @return no return
+void packRules(const Rules *rules, unsigned char *bytes);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks if the rules differ from the original game
+///
+/// @param rules rules
+/// @return true or false
+bool customRules(const Rules *rules);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// prints the rules if they differ from the original game
+///
+/// @param rules rules
+/// @return no return
+void printRules(const Rules *rules);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks if a spice is in play
+///
+/// @param rules rules
+/// @param spice spice
+/// @return true or false
+bool spiceAllowed(const Rules *rules, char spice);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks command line arguments for correctness and parses the config file
+/// checks command line arguments for correctness and parses the config file into the deck
 ///
 /// @param arg command line arguments
 /// @param count number of command line arguments
-/// @param stack main stack of cards
+/// @param deck deck to load
 /// @return return_code
-int checkCommandLine(char **arg, int count, Card **stack);
+int checkCommandLine(char **arg, int count, Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads a text or binary config file with a single read and builds the deck from the buffer
+///
+/// @param path path of the config file
+/// @param deck deck to load
+/// @return ALRIGHT, CANNOT_OPEN_FILE, INVALID_FILE or OUT_OF_MEMORY
+int loadDeck(const char *path, Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// parses a text config: the magic number line with optional rule settings, then one card VALUE_SPICE per line up
+/// to the end of the file or the first empty line, anything after it is ignored (older versions appended the results
+/// of games there)
+///
+/// @param path path of the config file for error messages
+/// @param buffer content of the file
+/// @param size size of the content
+/// @param deck deck to fill
+/// @return ALRIGHT, INVALID_FILE or OUT_OF_MEMORY
+int parseTextDeck(const char *path, const char *buffer, size_t size, Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// parses a binary config with its optional rules trailer and checks its checksum
+///
+/// @param path path of the config file for error messages
+/// @param buffer content of the file
+/// @param size size of the content
+/// @param deck deck to fill
+/// @return ALRIGHT, INVALID_FILE or OUT_OF_MEMORY
+int parseBinaryDeck(const char *path, const unsigned char *buffer, size_t size, Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the FNV-1a checksum of the packed cards of a binary deck
+///
+/// @param bytes packed cards
+/// @param count number of cards
+/// @return checksum
+uint32_t deckChecksum(const unsigned char *bytes, int count);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes the deck in the binary format
+///
+/// @param path path of the file to write
+/// @param deck deck to write
+/// @return ALRIGHT, CANNOT_OPEN_FILE or OUT_OF_MEMORY
+int writeBinaryDeck(const char *path, const Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the index of a spice in SPICES
+///
+/// @param spice spice
+/// @return index or NO_CARD if it is not a spice
+int spiceIndex(char spice);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// moves a card from one stack to the end of another
 ///
+/// @param cards card pool
 /// @param stack1 stack from
 /// @param stack2 stack to
-/// @param card card to move
+/// @param card index of the card to move
 /// @return no return
-void moveFromStackToStack(Card **stack1, Card **stack2, Card *card);
+void moveFromStackToStack(Card *cards, Stack *stack1, Stack *stack2, int card);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// sorts a stack of cards by value in ascending order
+/// appends all cards of one stack to the end of another and empties it
 ///
-/// @param stack stack to sort
+/// @param cards card pool
+/// @param stack stack to append to
+/// @param other stack to append
 /// @return no return
-void sortStackByValue(Card **stack);
+void appendStack(Card *cards, Stack *stack, Stack *other);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the sort key of a card: spices in the order c, p, w and values ascending inside a spice
+///
+/// @param card card
+/// @return sort key between 0 and CARD_KEYS - 1
+int cardKey(const Card *card);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// sorts a stack of cards by spice and value
+/// sorts a stack of cards by spice and value with a counting sort over the card keys
 ///
+/// @param cards card pool
 /// @param stack stack to sort
 /// @return no return
-void sortStack(Card **stack);
+void sortStack(Card *cards, Stack *stack);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// distributes cards from the main stack to players hands
+/// sorts the hand of a player and builds its index
 ///
-/// @param stack main stack
-/// @param player_1 player 1
-/// @param player_2 player 2
+/// @param cards card pool
+/// @param player player
 /// @return no return
-void distributeCards(Card **stack, Player *player_1, Player *player_2);
+void sortHand(Card *cards, Player *player);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// prints a stack of cards
+/// moves a card from a stack into its place in a hand, behind the cards of the same key, in constant time
 ///
-/// @param stack stack to print
+/// @param cards card pool
+/// @param stack stack from
+/// @param player player getting the card
+/// @param card index of the card to move
 /// @return no return
-void printStack(Card *stack);
+void moveIntoHand(Card *cards, Stack *stack, Player *player, int card);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// prints information about the players hand and about the latest played card
+/// moves a card from a hand to the end of a stack in constant time
 ///
-/// @param player player
-/// @param last_card bool if its last card
-/// @param played number of cards played this round
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param latest_played latest played card
+/// @param cards card pool
+/// @param player player giving the card
+/// @param stack stack to
+/// @param card index of the card to move
 /// @return no return
-void printPlayer(Player *player, bool last_card, int played, int said_value, char said_spice, Card *latest_played);
+void moveOutOfHand(Card *cards, Player *player, Stack *stack, int card);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// creates an input buffer and dynamically allocates memory to it using malloc()
-/// reads the input character by character and stores it on the heap, updating the buffer using realloc() as needed
+/// checks if a card is in the hand of a player by looking at the cards of its key only
 ///
-/// @return char pointer to the created input buffer
-char *getInput(void);
+/// @param cards card pool
+/// @param player player
+/// @param card index of the card
+/// @return true or false
+bool inHand(const Card *cards, const Player *player, int card);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks the format of the inputted card
+/// allocates a game for the deck
 ///
-/// @param card inputted card
-/// @param value inputted value
-/// @param spice inputted spice
+/// @param deck deck of the game
+/// @param players number of players, 2 to MAX_PLAYERS
+/// @return game or NULL if out of memory
+Game *createGame(const Deck *deck, int players);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the size of the allocation of a game
+///
+/// @param game game
+/// @return size in bytes
+size_t gameSize(const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the FNV-1a hash of all bytes of a game
+///
+/// @param game game
+/// @return hash
+uint64_t hashGame(const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks that the stacks of a game link every card exactly once and the turn is valid
+///
+/// @param game game
 /// @return true or false
-bool checkCardFormat(char *card, int *value, char *spice);
+bool checkGame(const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes a game with a header holding its layout and hash
+///
+/// @param path path of the file
+/// @param game game
+/// @return ALRIGHT or CANNOT_OPEN_FILE
+int saveGame(const char *path, const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// replaces a game with a saved game of the same number of cards
+///
+/// @param path path of the file
+/// @param game game to replace
+/// @return ALRIGHT, CANNOT_OPEN_FILE, INVALID_FILE or OUT_OF_MEMORY
+int loadGame(const char *path, Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// puts the cards of the deck into the main stack, resets the players and distributes the cards
+///
+/// @param game game to reset
+/// @param deck deck of the game
+/// @param random random state to shuffle the cards with or NULL to keep the order of the deck
+/// @return no return
+void resetGame(Game *game, const Deck *deck, uint64_t *random);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// distributes up to a full hand to every player, one card per player at a time while there are enough for everyone
+///
+/// @param game game
+/// @return no return
+void distributeCards(Game *game);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// looks for the card in the stack of cards by the value and spice
+/// looks for a card in the hand of a player by the value and spice through the index of the hand
 ///
-/// @param stack to look in
+/// @param player player whose hand to look in
 /// @param value to look for
 /// @param spice to look for
-/// @return Card pointer to this card
-Card *findCard(Card *stack, int value, char spice);
+/// @return index of this card or NO_CARD
+int findCard(const Player *player, int value, char spice);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// play <arg1> <arg2> command plays a card and says its value and spice
+/// checks if the player on turn may use this kind of action at the moment
 ///
-/// @param arg1 played card
-/// @param arg2 said card
-/// @param player player
-/// @param latest_played latest played card
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param last_card bool if its last card
-/// @param discard discard pile
-/// @param played number of cards played this round
+/// @param game game
+/// @param type type of the action
 /// @return true or false
-bool playCommand(char *arg1, char *arg2, Player *player, Card **latest_played, int *said_value, char *said_spice,
-                 bool *last_card, Card **discard, int *played);
+bool actionAllowed(const Game *game, Action_type type);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the player after this one in the turn order ring
+///
+/// @param game game
+/// @param player index of the player
+/// @return index of the next player
+int nextPlayer(const Game *game, int player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the player before this one in the turn order ring, who played the card this one may challenge
+///
+/// @param game game
+/// @param player index of the player
+/// @return index of the previous player
+int previousPlayer(const Game *game, int player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the most points any other player has
+///
+/// @param game game
+/// @param player index of the player
+/// @return points
+int highestOtherPoints(const Game *game, int player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks an action of the player on turn against the rules
+///
+/// @param game game
+/// @param action action to check
+/// @return ALRIGHT or the broken rule: NOT_ALLOWED, NOT_IN_HAND, INVALID_VALUE, INVALID_SPICE or INVALID_ACTION
+int checkAction(const Game *game, const Action *action);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the values which may be said after a said value: from 1 up to the restart value of the rules at the start
+/// of a round and once the wrap value is reached, else the said value up to the wrap value
+///
+/// @param rules rules of the game
+/// @param said_value latest said value, 0 at the start of a round
+/// @param lowest lowest value to fill
+/// @param highest highest value to fill
+/// @return true if the values start again, false if not
+bool valuesAfter(const Rules *rules, int said_value, int *lowest, int *highest);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the values the player on turn may say, see valuesAfter
+///
+/// @param game game
+/// @param lowest lowest value to fill
+/// @param highest highest value to fill
+/// @return no return
+void allowedValues(const Game *game, int *lowest, int *highest);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// lists every legal action of the player on turn: each allowed challenge, draw and each card key in the hand with
+/// every value and spice it may be said to be, ordered by card key, then said value, then said spice
+///
+/// @param game game
+/// @param moves array of at least MAX_LEGAL_MOVES actions to fill
+/// @return number of moves
+int listLegalMoves(const Game *game, Action *moves);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// plays a card and says its value and spice
+///
+/// @param game game
+/// @param action play action
+/// @return no return
+void playCommand(Game *game, const Action *action);
 
 //---------------------------------------------------------------------------------------------------------------------
 /// draws additional cards at the end of the round
 ///
-/// @param loser loser of the round
-/// @param winner winner of the round
-/// @param stack main stack of cards
+/// @param game game
+/// @param loser index of the loser of the round
+/// @param winner index of the winner of the round
 /// @return no return
-void drawAdditionalCards(Player *loser, Player *winner, Card **stack);
+void drawAdditionalCards(Game *game, int loser, int winner);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// challenge <arg1> challenges the opponents played card in either value or spice
+/// challenges the opponents played card in either value or spice and ends the round
 ///
-/// @param arg1 played card
-/// @param player player
-/// @param opponent opponent
-/// @param latest_played latest played card
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param last_card bool if its last card
-/// @param discard discard pile
-/// @param stack main stack of cards
-/// @param played number of cards played this round
-/// @return true or false
-bool challengeCommand(char *arg1, Player *player, Player *opponent, Card **latest_played, int *said_value,
-                      char *said_spice, bool *last_card, Card **discard, Card **stack, int *played);
+/// @param game game
+/// @param action challenge action
+/// @param event event to fill with the result of the challenge
+/// @return no return
+void challengeCommand(Game *game, const Action *action, Event *event);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// draw draws additional card from the main stack of cards
+/// draws additional card from the main stack of cards
 ///
-/// @param player player
-/// @param stack main stack of cards
+/// @param game game
 /// @return no return
-void drawCommand(Player *player, Card **stack);
+void drawCommand(Game *game);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks input for quit command
+/// does a checked action of the player on turn and passes the turn on
+///
+/// @param game game
+/// @param action action to do
+/// @param event event to fill with what happened
+/// @return CHALLENGE if the round ended or ALRIGHT
+int doAction(Game *game, const Action *action, Event *event);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// sends an event to the spectators and all agents that observe the game
+///
+/// @param game game
+/// @param agents agents of the players
+/// @param spectators spectators
+/// @param spectator_count number of spectators
+/// @param event event to send
+/// @return no return
+void notifyAgents(const Game *game, Agent *agents, Agent *spectators, int spectator_count, const Event *event);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// main loop of the engine, asks the agents for their actions until the main stack of cards is empty
+///
+/// @param game game
+/// @param agents agents of the players
+/// @param spectators spectators
+/// @param spectator_count number of spectators
+/// @return ALRIGHT if the game finished, QUIT, OUT_OF_MEMORY or INVALID_ACTION
+int runGame(Game *game, Agent *agents, Agent *spectators, int spectator_count);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// prints a stack of cards
 ///
-/// @param input input
+/// @param cards card pool
+/// @param stack stack to print
 /// @return no return
-bool checkQuit(char *input);
+void printStack(const Card *cards, const Stack *stack);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks input for play command
+/// prints information about the players hand and about the latest played card
 ///
-/// @param input input
+/// @param game game
 /// @param player player
-/// @param latest_played latest played card
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param last_card bool if its last card
-/// @param discard discard pile
-/// @param played number of cards played this round
+/// @return no return
+void printPlayer(const Game *game, const Player *player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads one line into the line buffer of the console, which only grows when a line is longer than all before,
+/// and converts it to lower case
+///
+/// @param console console
+/// @param line slice to set to the line without the line break
+/// @return ALRIGHT, QUIT at the end of the input or OUT_OF_MEMORY
+int getInput(Console *console, Slice *line);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// splits the next word separated by spaces off the rest of the line
+///
+/// @param rest rest of the line, moved behind the word
+/// @param token slice to set to the word
+/// @return true if there was a word
+bool nextToken(Slice *rest, Slice *token);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks that a token is this word
+///
+/// @param token token
+/// @param word word
 /// @return true or false
-bool checkPlay(char *input, Player *player, Card **latest_played, int *said_value, char *said_spice,
-               bool *last_card, Card **discard, int *played);
+bool tokenIs(Slice token, const char *word);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks input for challenge command
+/// returns the command of the first word of a line, switching on its first letter
 ///
-/// @param input input
-/// @param player player
-/// @param opponent opponent
-/// @param latest_played latest played card
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param last_card bool if its last card
-/// @param discard discard pile
-/// @param stack main stack of cards
-/// @param played number of cards played this round
+/// @param token first word
+/// @return command or COMMAND_INVALID
+Command parseCommand(Slice token);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks the format of the inputted card
+///
+/// @param card inputted card
+/// @param value inputted value
+/// @param spice inputted spice
 /// @return true or false
-bool checkChallenge(char *input, Player *player, Player *opponent, Card **latest_played, int *said_value,
-                    char *said_spice, bool *last_card, Card **discard, Card **stack, int *played);
+bool checkCardFormat(Slice card, int *value, char *spice);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// checks input for draw command
+/// returns the message for an action which breaks the rules
 ///
-/// @param input input
-/// @param player player
-/// @param stack main stack of cards
-/// @param last_card bool if its last card
+/// @param return_code result of checkAction()
+/// @return message
+const char *actionError(int return_code);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks input for quit command
+///
+/// @param rest rest of the line
 /// @return true or false
-bool checkDraw(char *input, Player *player, Card **stack, bool *last_card);
+bool checkQuit(Slice *rest);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// reads input, checks input and does the command given by the input
+/// reads the parameters of a play, challenge or draw command into an action and checks it against the rules
 ///
-/// @param player player
-/// @param opponent opponent
-/// @param latest_played latest played card
-/// @param said_value said value
-/// @param said_spice said spice
-/// @param last_card bool if its last card
-/// @param stack main stack of cards
-/// @param discard discard pile
-/// @param played number of cards played this round
-/// @return return_code
-int readAndDoAction(Player *player,Player *opponent, Card **latest_played, int *said_value, char *said_spice,
-                    bool *last_card, Card **stack, Card **discard, int *played);
+/// @param command command
+/// @param rest rest of the line
+/// @param game game
+/// @param action action to fill
+/// @return NULL if the action is valid, else the message why not
+const char *parseAction(Command command, Slice *rest, const Game *game, Action *action);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// main loop of the game
+/// checks input for play, challenge and draw commands and prints why it is not valid
 ///
-/// @param stack main stack of cards
-/// @param player_1 player 1
-/// @param player_2 player 2
-/// @param discard discard pile
-/// @return return_code
-int playingTheGame(Card **stack, Player *player_1, Player *player_2, Card **discard);
+/// @param command command
+/// @param rest rest of the line
+/// @param game game
+/// @param action action to fill
+/// @return true or false
+bool checkCommand(Command command, Slice *rest, const Game *game, Action *action);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// prints the score board and saves the result into file
+/// checks input for hint command, prints the legal moves of the player on turn and suggests one
 ///
-/// @param arg command line argument - file path
-/// @param player_1 player 1
-/// @param player_2 player 2
+/// @param rest rest of the line
+/// @param game game
 /// @return no return
-void finishingTheGame(char **arg, Player *player_1, Player *player_2);
+void checkHint(Slice *rest, const Game *game);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// frees the allocated memory of the linked list
+/// checks input for save command and saves the game
 ///
-/// @param stack stack of cards
+/// @param rest rest of the line, the file name is terminated in place
+/// @param game game
 /// @return no return
-void freeStack(Card **stack);
+void checkSave(Slice *rest, const Game *game);
 
 //---------------------------------------------------------------------------------------------------------------------
-/// main function contains main stack of cards, discard pile and two players, also frees allocated memory at the end
+/// checks input for load command and loads the game
 ///
-/// @return integer exit code
-int main(int argc, char *argv[])
-{
-  int return_code;
-  Card *stack = NULL;
-  return_code = checkCommandLine(argv, argc, &stack);
-  if(return_code == INVALID_USAGE ||
-     return_code == CANNOT_OPEN_FILE ||
-     return_code == INVALID_FILE ||
-     return_code == OUT_OF_MEMORY)
-  {
-    return return_code;
-  }
-  printf("Welcome to Entertaining Spice Pretending!\n");
-  Player player_1;
-  Player player_2;
-  distributeCards(&stack, &player_1, &player_2);
-  Card *discard = NULL;
-  return_code = playingTheGame(&stack, &player_1, &player_2, &discard);
-  if(return_code == QUIT ||
-     return_code == OUT_OF_MEMORY)
-  {
-    freeStack(&stack);
-    freeStack(&discard);
-    freeStack(&player_1.hand_);
-    freeStack(&player_2.hand_);
-    return return_code;
-  }
-  finishingTheGame(argv, &player_1, &player_2);
-  freeStack(&stack);
-  freeStack(&discard);
-  freeStack(&player_1.hand_);
-  freeStack(&player_2.hand_);
+/// @param rest rest of the line, the file name is terminated in place
+/// @param game game to replace
+/// @return true if the game was loaded
+bool checkLoad(Slice *rest, Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// human agent: prints the player, reads input and checks it until it is a valid action
+///
+/// @param game game
+/// @param player index of the player on turn
+/// @param action action to fill
+/// @param context console with the same game, writable for the load command
+/// @return ALRIGHT, QUIT, OUT_OF_MEMORY or LOADED
+int readAndDoAction(const Game *game, int player, Action *action, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// console spectator: prints the start of the rounds and the results of challenges
+///
+/// @param game game
+/// @param event what happened
+/// @param context not used
+/// @return no return
+void printEvent(const Game *game, const Event *event, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// plays the game on the console, all players but player 1 are bots if a strategy is given
+///
+/// @param game game
+/// @param opponent strategy of the bots or NULL for human players only
+/// @param log results log or NULL
+/// @param recorder recorder of a replay or NULL
+/// @return return_code
+int playingTheGame(Game *game, const Strategy *opponent, Log *log, Recorder *recorder);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// prints the score board from the most points to the least and congratulates everyone with the most points
+///
+/// @param game finished game
+/// @return no return
+void finishingTheGame(const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// opens the results log for appending
+///
+/// @param path path of the log
+/// @return file descriptor or -1
+int openLogFile(const char *path);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// initializes a buffered writer of the results log
+///
+/// @param log log
+/// @param file file descriptor of the log
+/// @param lock lock shared by all writers of the file or NULL
+/// @return ALRIGHT or OUT_OF_MEMORY
+int initLog(Log *log, int file, pthread_mutex_t *lock);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// adds a record to the buffer of the log and writes the buffer when it is full
+///
+/// @param log log
+/// @param record record
+/// @return no return
+void logRecord(Log *log, const Log_record *record);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes the buffered records to the file
+///
+/// @param log log
+/// @return no return
+void flushLog(Log *log);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes the buffered records and frees the buffer, the file is closed by its owner
+///
+/// @param log log
+/// @return true if all records were written
+bool freeLog(Log *log);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// starts a match in the log
+///
+/// @param logger logger
+/// @param log log
+/// @param match id of the match
+/// @param game game at its start
+/// @param agent_1 agent of player 1, 0 for a human and 1 + the strategy kind for a bot
+/// @param agent_2 agent of the other players
+/// @return no return
+void logMatchStart(Logger *logger, Log *log, uint64_t match, const Game *game, int agent_1, int agent_2);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// log spectator: writes every move of the match into the log
+///
+/// @param game game
+/// @param event what happened
+/// @param context logger
+/// @return no return
+void logEvent(const Game *game, const Event *event, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// ends a finished match in the log with the points of the players
+///
+/// @param logger logger
+/// @param game finished game
+/// @return no return
+void logMatchEnd(Logger *logger, const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the checksum of a deck in the packed form of a binary deck, including the rules trailer if it has one
+///
+/// @param deck deck
+/// @return checksum
+uint32_t packedDeckChecksum(const Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the FNV-1a checksum of the points of all players
+///
+/// @param game game
+/// @return checksum
+uint32_t scoreChecksum(const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// adds an entry to a recorder, growing its array as needed
+///
+/// @param recorder recorder
+/// @param entry entry
+/// @return no return
+void recordEntry(Recorder *recorder, const Replay_entry *entry);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// replay spectator: records every action, a loaded game cannot be replayed any more
+///
+/// @param game game
+/// @param event what happened
+/// @param context recorder
+/// @return no return
+void recordEvent(const Game *game, const Event *event, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes a recorded game as a replay file
+///
+/// @param path path of the replay
+/// @param recorder recorder of the game
+/// @param deck deck of the game
+/// @param seed seed of the shuffle
+/// @param shuffled whether the deck was shuffled
+/// @param game game after the last action
+/// @return ALRIGHT, CANNOT_OPEN_FILE or INVALID_FILE if the game cannot be replayed
+int writeReplay(const char *path, Recorder *recorder, const Deck *deck, uint64_t seed, bool shuffled,
+                const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// plays a replay through the rules without any output and checks the scores after every round
+///
+/// @param path path of the replay
+/// @param deck deck of the config
+/// @return QUIT, CANNOT_OPEN_FILE, INVALID_FILE or OUT_OF_MEMORY
+int replayGame(const char *path, const Deck *deck);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads a results log and prints the results of all finished matches per pair of agents
+///
+/// @param path path of the log
+/// @return QUIT, CANNOT_OPEN_FILE or INVALID_FILE
+int queryLog(const char *path);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the name of an agent of the results log
+///
+/// @param agent 0 for a human and 1 + the strategy kind for a bot
+/// @return name
+const char *agentName(int agent);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// checks the options given after the config file
+///
+/// @param arg command line arguments
+/// @param count number of command line arguments
+/// @param options options to fill
+/// @return ALRIGHT or INVALID_USAGE
+int parseOptions(char **arg, int count, Options *options);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the next number of a splitmix64 random generator
+///
+/// @param random random state
+/// @return random number
+uint64_t nextRandom(uint64_t *random);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// shuffles the values and spices of cards with Fisher-Yates
+///
+/// @param cards cards to shuffle
+/// @param count number of cards
+/// @param random random state
+/// @return no return
+void shuffleCards(Card *cards, int count, uint64_t *random);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// parses a comma separated list of non-negative weights, at least one of them above zero
+///
+/// @param text list
+/// @param weights weights to fill
+/// @param count number of weights the list must have
+/// @return true if the list is valid
+bool parseWeights(const char *text, int *weights, int count);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns a random index with a chance proportional to its weight
+///
+/// @param weights weights
+/// @param count number of weights
+/// @param random random state
+/// @return index
+int pickWeighted(const int *weights, int count, uint64_t *random);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// fills a deck with random cards, spices and values drawn independently by their weights
+///
+/// @param deck deck to fill
+/// @param options number of cards, weights and seed
+/// @return ALRIGHT or OUT_OF_MEMORY
+int generateDeck(Deck *deck, const Options *options);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// writes the deck as a text config
+///
+/// @param path path of the file to write
+/// @param deck deck to write
+/// @param replace true to replace an existing file, false to refuse it
+/// @return ALRIGHT, CANNOT_OPEN_FILE or OUT_OF_MEMORY
+int writeTextDeck(const char *path, const Deck *deck, bool replace);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// looks for the lowest card in the hand of a player that can be played honestly at the moment
+///
+/// @param game game
+/// @param player player whose hand to look in
+/// @return index of this card or NO_CARD
+int findHonestCard(const Game *game, const Player *player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// fills the strategies with the options, indexed by their kind
+///
+/// @param strategies strategies to fill
+/// @param options options
+/// @return no return
+void initStrategies(Strategy *strategies, const Options *options);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// initializes a bot for a new game
+///
+/// @param bot bot
+/// @param strategy strategy of the bot
+/// @param player index of the player of the bot
+/// @param seed seed of the random generator of the bot
+/// @return no return
+void initBot(Bot *bot, const Strategy *strategy, int player, uint64_t seed);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// marks a card as seen by a counting bot
+///
+/// @param bot bot
+/// @param game game
+/// @param card index of the card
+/// @return no return
+void markSeen(Bot *bot, const Game *game, int card);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the probability that none of the drawn cards is one of the marked cards
+///
+/// @param unseen number of cards to draw from
+/// @param marked number of marked cards among them
+/// @param draws number of cards drawn
+/// @return probability
+double missProbability(int unseen, int marked, int draws);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// estimates the probability that the latest claim of the opponent is a lie from the cards the bot has not seen
+///
+/// @param bot bot
+/// @param game game, the latest played card is from the opponent
+/// @return probability
+double lieProbability(const Bot *bot, const Game *game);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// counting bot: challenges by the probability of a lie, plays the card which leaves the opponent the smallest
+/// chance to answer honestly as long as the time budget lasts, and bluffs with claims it cannot be disproven on
+///
+/// @param game game
+/// @param action action to fill
+/// @param bot bot
+/// @return ALRIGHT
+int countingDecide(const Game *game, Action *action, Bot *bot);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the kind of the strategy with this name
+///
+/// @param name name of the strategy
+/// @return kind or NO_CARD if there is no such strategy
+int strategyKind(const char *name);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// frees the search buffers of a bot after its game
+///
+/// @param bot bot
+/// @return no return
+void freeBot(Bot *bot);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// lists the moves of the player on turn the search tries: like listLegalMoves, but for each card key in the hand only
+/// one play, honest if the card can be played honestly, else a bluff with the lowest value allowed
+///
+/// @param game game
+/// @param moves array of at least MAX_MOVES actions to fill
+/// @return number of moves
+int listMoves(const Game *game, Action *moves);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the key of a move as the observer sees it, the real card of a play is only part of it for own moves
+///
+/// @param game game before the move
+/// @param move move
+/// @param observer index of the observing player
+/// @return key of the move
+int moveKey(const Game *game, const Action *move, int observer);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// copies the game into the simulation and deals the cards the bot has not seen randomly to their places,
+/// the face down card is the said one as often as the claim is estimated to be true
+///
+/// @param search search
+/// @return no return
+void determinize(Search *search);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// picks the move of a playout: mostly an honest play, a draw or a forced challenge, sometimes a random move
+///
+/// @param game game
+/// @param moves moves of the player on turn
+/// @param count number of moves
+/// @param random random state
+/// @return index of the move
+int playoutMove(const Game *game, Action *moves, int count, uint64_t *random);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// returns the result of a finished game for a player, 1 for a win, 0.5 for a tie and 0 for a loss
+///
+/// @param game finished game
+/// @param player index of the player
+/// @return result
+double gameResult(const Game *game, int player);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// search thread: runs iterations of selection, expansion, playout and backpropagation on its own tree
+///
+/// @param argument search
+/// @return NULL
+void *searchThread(void *argument);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// mcts bot: searches the moves on its threads and plays the move visited most over all trees
+///
+/// @param game game
+/// @param action action to fill
+/// @param bot bot
+/// @return ALRIGHT or OUT_OF_MEMORY
+int mctsDecide(const Game *game, Action *action, Bot *bot);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// console bot agent: decides like a bot and prints the command without the real card
+///
+/// @param game game
+/// @param player index of the player on turn
+/// @param action action to fill
+/// @param context bot
+/// @return ALRIGHT or OUT_OF_MEMORY
+int consoleBotDecide(const Game *game, int player, Action *action, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// bot agent: plays honestly if it can, else draws or bluffs, and challenges as its strategy says
+///
+/// @param game game
+/// @param player index of the player on turn
+/// @param action action to fill
+/// @param context bot
+/// @return ALRIGHT or OUT_OF_MEMORY
+int botDecide(const Game *game, int player, Action *action, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// bot agent: remembers the said values of the round and the cards revealed by challenges
+///
+/// @param game game
+/// @param event what happened
+/// @param context bot
+/// @return no return
+void botObserve(const Game *game, const Event *event, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// tournament spectator: counts rounds and challenges of a game
+///
+/// @param game game
+/// @param event what happened
+/// @param context tally of the pairing
+/// @return no return
+void tallyEvent(const Game *game, const Event *event, void *context);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// tournament thread, plays chunks of games until all games are played
+///
+/// @param argument worker
+/// @return NULL
+void *tournamentThread(void *argument);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// plays every strategy against every strategy on multiple threads and prints the results
+///
+/// @param deck deck of the games
+/// @param options options of the tournament
+/// @return QUIT or OUT_OF_MEMORY
+int runTournament(const Deck *deck, const Options *options);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// prints the results of one pairing
+///
+/// @param first name of player 1
+/// @param second name of the other players
+/// @param tally results
+/// @return no return
+void printTally(const char *first, const char *second, const Tally *tally);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// sends text to a client of the server without waiting, a client too slow to take it is shut down and closed by
+/// the event loop
+///
+/// @param client socket of the client
+/// @param text text
+/// @param length length of the text
+/// @return no return
+void sendText(int client, const char *text, size_t length);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// formats text in the reply buffer of the server and sends it to a client
+///
+/// @param server server
+/// @param client socket of the client
+/// @param format format of the text
+/// @return no return
+void sendClient(Server *server, int client, const char *format, ...);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// sends text to every player at a table
+///
+/// @param server server
+/// @param table table
+/// @param text text
+/// @return no return
+void sendTable(Server *server, const Table *table, const char *text);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// sends what the player on turn sees of the game to the client of that player
+///
+/// @param server server
+/// @param table table
+/// @return no return
+void sendTurn(Server *server, const Table *table);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// tells everyone at a table what an action did
+///
+/// @param server server
+/// @param table table
+/// @param event event of the action
+/// @return no return
+void sendEvent(Server *server, const Table *table, const Event *event);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// ends the game of a table, tells everyone the points and closes their connections so the table can be used again
+///
+/// @param server server
+/// @param table table
+/// @param reason why the game ended
+/// @return no return
+void closeTable(Server *server, Table *table, const char *reason);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// closes a connection, the game at its table ends if it was playing
+///
+/// @param server server
+/// @param client socket of the client
+/// @return no return
+void dropClient(Server *server, int client);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// seats a client at a table and deals the game when the table is full
+///
+/// @param server server
+/// @param client socket of the client
+/// @param rest rest of the line with the number of the table
+/// @return no return
+void joinTable(Server *server, int client, Slice *rest);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// handles one line of a client
+///
+/// @param server server
+/// @param client socket of the client
+/// @param line line without the line break
+/// @return no return
+void handleLine(Server *server, int client, Slice line);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// reads what a client sent and handles every complete line
+///
+/// @param server server
+/// @param client socket of the client
+/// @return no return
+void readClient(Server *server, int client);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// accepts all waiting connections
+///
+/// @param server server
+/// @return no return
+void acceptClients(Server *server);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// serves many tables on one thread over a local socket with an epoll event loop until SIGINT or SIGTERM arrives
+/// or an error occurs, an existing file at the socket path is only replaced if it is a socket
+///
+/// @param deck deck of the games
+/// @param options socket path, number of tables and players per table, shuffle and seed
+/// @return QUIT, CANNOT_OPEN_FILE or OUT_OF_MEMORY
+int runServer(const Deck *deck, const Options *options);
+
+//---------------------------------------------------------------------------------------------------------------------
+/// main function contains the deck and the game, also frees allocated memory at the end
+///
+/// @return integer exit code
+int main(int argc, char *argv[])
+{
+  int return_code;
+  Deck deck;
+  Options options;
+  if(argc == 3 && strcmp(argv[1], "--query") == 0)
+  {
+    return queryLog(argv[2]);
+  }
+  if(parseOptions(argv, argc, &options) != ALRIGHT)
+  {
+    return INVALID_USAGE;
+  }
+  if(options.generate_ > 0)
+  {
+    return_code = generateDeck(&deck, &options);
+    if(return_code != ALRIGHT)
+    {
+      return return_code;
+    }
+    return_code = writeTextDeck(argv[1], &deck, options.force_);
+    if(return_code == ALRIGHT)
+    {
+      printf("Generated %d cards to %s\n", deck.count_, argv[1]);
+      return_code = QUIT;
+    }
+    free(deck.cards_);
+    return return_code;
+  }
+  return_code = checkCommandLine(argv, argc, &deck);
+  if(return_code == INVALID_USAGE ||
+     return_code == CANNOT_OPEN_FILE ||
+     return_code == INVALID_FILE ||
+     return_code == OUT_OF_MEMORY)
+  {
+    return return_code;
+  }
+  if(options.convert_ != NULL)
+  {
+    return_code = writeBinaryDeck(options.convert_, &deck);
+    if(return_code == ALRIGHT)
+    {
+      printf("Converted %d cards to %s\n", deck.count_, options.convert_);
+      return_code = QUIT;
+    }
+    free(deck.cards_);
+    return return_code;
+  }
+  if(options.replay_ != NULL)
+  {
+    return_code = replayGame(options.replay_, &deck);
+    free(deck.cards_);
+    return return_code;
+  }
+  if(options.tournament_games_ > 0)
+  {
+    return_code = runTournament(&deck, &options);
+    free(deck.cards_);
+    return return_code;
+  }
+  if(options.serve_ != NULL)
+  {
+    return_code = runServer(&deck, &options);
+    free(deck.cards_);
+    return return_code;
+  }
+  Game *game = createGame(&deck, options.players_);
+  if(game == NULL)
+  {
+    printf("Error: Out of memory\n");
+    free(deck.cards_);
+    return OUT_OF_MEMORY;
+  }
+  printf("Welcome to Entertaining Spice Pretending!\n");
+  printRules(&deck.rules_);
+  // without a seed every shuffled game is different, the seed is printed so the game can be played again
+  uint64_t seed = options.seeded_ ? options.seed_ : ((uint64_t)time(NULL) << 32 ^ (uint64_t)getpid());
+  if(options.shuffle_)
+  {
+    printf("Shuffled with seed %llu\n", (unsigned long long)seed);
+  }
+  uint64_t random = seed;
+  resetGame(game, &deck, options.shuffle_ ? &random : NULL);
+  Strategy strategies[STRATEGY_COUNT];
+  initStrategies(strategies, &options);
+  const Strategy *opponent = options.bot_ != NULL ? &strategies[strategyKind(options.bot_)] : NULL;
+  // the results are logged next to the config unless another log is given
+  char log_path[4096];
+  snprintf(log_path, sizeof(log_path), "%s.log", argv[1]);
+  Log log;
+  int log_file = openLogFile(options.log_ != NULL ? options.log_ : log_path);
+  bool logging = log_file >= 0 && initLog(&log, log_file, NULL) == ALRIGHT;
+  Recorder recorder = {NULL, 0, 0, false, false};
+  return_code = playingTheGame(game, opponent, logging ? &log : NULL, options.record_ != NULL ? &recorder : NULL);
+  if(return_code == ALRIGHT)
+  {
+    finishingTheGame(game);
+  }
+  if(options.record_ != NULL && return_code != OUT_OF_MEMORY)
+  {
+    int record_code = writeReplay(options.record_, &recorder, &deck, seed, options.shuffle_, game);
+    if(record_code == INVALID_FILE)
+    {
+      printf("Warning: Replay not written, a loaded game cannot be replayed!\n");
+    }
+    else if(record_code != ALRIGHT)
+    {
+      printf("Warning: Replay not written to file!\n");
+    }
+  }
+  free(recorder.entries_);
+  if(!logging || !freeLog(&log))
+  {
+    if(return_code == ALRIGHT)
+    {
+      printf("Warning: Results not written to file!\n");
+    }
+  }
+  if(log_file >= 0)
+  {
+    close(log_file);
+  }
+  free(game);
+  free(deck.cards_);
+  return return_code == OUT_OF_MEMORY ? OUT_OF_MEMORY : QUIT;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+//functions
+
+void initStack(Stack *stack)
+{
+  stack->first_ = NO_CARD;
+  stack->last_ = NO_CARD;
+  stack->count_ = 0;
+}
+
+void insertCardEnd(Card *cards, Stack *stack, int card)
+{
+  insertCardBefore(cards, stack, card, NO_CARD);
+}
+
+void insertCardBefore(Card *cards, Stack *stack, int card, int before)
+{
+  int previous = (before == NO_CARD) ? stack->last_ : cards[before].previous_;
+  cards[card].next_ = before;
+  cards[card].previous_ = previous;
+  if(previous != NO_CARD)
+  {
+    cards[previous].next_ = card;
+  }
+  else
+  {
+    stack->first_ = card;
+  }
+  if(before != NO_CARD)
+  {
+    cards[before].previous_ = card;
+  }
+  else
+  {
+    stack->last_ = card;
+  }
+  stack->count_++;
+}
+
+void removeCard(Card *cards, Stack *stack, int card)
+{
+  if(cards[card].previous_ != NO_CARD)
+  {
+    cards[cards[card].previous_].next_ = cards[card].next_;
+  }
+  else
+  {
+    stack->first_ = cards[card].next_;
+  }
+  if(cards[card].next_ != NO_CARD)
+  {
+    cards[cards[card].next_].previous_ = cards[card].previous_;
+  }
+  else
+  {
+    stack->last_ = cards[card].previous_;
+  }
+  cards[card].next_ = NO_CARD;
+  cards[card].previous_ = NO_CARD;
+  stack->count_--;
+}
+
+int checkCommandLine(char **arg, int count, Deck *deck)
+{
+  if(count < 2)
+  {
+    printf(USAGE);
+    return INVALID_USAGE;
+  }
+  return loadDeck(arg[1], deck);
+}
+
+int loadDeck(const char *path, Deck *deck)
+{
+  int file = open(path, O_RDONLY);
+  struct stat status;
+  if(file < 0 || fstat(file, &status) != 0)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    if(file >= 0)
+    {
+      close(file);
+    }
+    return CANNOT_OPEN_FILE;
+  }
+  size_t size = (size_t)status.st_size;
+  char *buffer = malloc(size + 1);
+  if(buffer == NULL)
+  {
+    printf("Error: Out of memory\n");
+    close(file);
+    return OUT_OF_MEMORY;
+  }
+  ssize_t bytes = read(file, buffer, size);
+  close(file);
+  if(bytes != (ssize_t)size)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    free(buffer);
+    return CANNOT_OPEN_FILE;
+  }
+  buffer[size] = '\0';
+  int return_code;
+  if(size >= BINARY_HEADER && memcmp(buffer, BINARY_MAGIC, 4) == 0)
+  {
+    return_code = parseBinaryDeck(path, (const unsigned char *)buffer, size, deck);
+  }
+  else
+  {
+    return_code = parseTextDeck(path, buffer, size, deck);
+  }
+  free(buffer);
+  return return_code;
+}
+
+int parseTextDeck(const char *path, const char *buffer, size_t size, Deck *deck)
+{
+  const char *header_end = memchr(buffer, '\n', size);
+  size_t header_length = header_end != NULL ? (size_t)(header_end - buffer) : size;
+  if(header_length > 0 && buffer[header_length - 1] == '\r')
+  {
+    header_length--;
+  }
+  initRules(&deck->rules_);
+  if(header_end == NULL || header_length < 3 || memcmp(buffer, "ESP", 3) != 0 ||
+     (header_length > 3 && buffer[3] != ' ') || !parseRules(buffer + 3, header_length - 3, &deck->rules_))
+  {
+    printf("Error: Invalid file: %s\n", path);
+    return INVALID_FILE;
+  }
+  // every card line has at least 3 characters and a line break, so this is enough for all cards
+  deck->count_ = 0;
+  deck->cards_ = malloc((size / 4 + 1) * sizeof(Card));
+  if(deck->cards_ == NULL)
+  {
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  const char *position = header_end + 1;
+  const char *end = buffer + size;
+  int line = 2;
+  while(position < end)
+  {
+    const char *line_end = memchr(position, '\n', end - position);
+    if(line_end == NULL)
+    {
+      line_end = end;
+    }
+    size_t length = line_end - position;
+    if(length > 0 && position[length - 1] == '\r')
+    {
+      length--;
+    }
+    if(length == 0)
+    {
+      break;
+    }
+    int value = 0;
+    size_t digits = 0;
+    while(digits < length && digits < 2 && isdigit((unsigned char)position[digits]))
+    {
+      value = value * 10 + position[digits] - '0';
+      digits++;
+    }
+    if(digits == 0 || value < 1 || value > MAX_VALUE || length != digits + 2 || position[digits] != '_' ||
+       !spiceAllowed(&deck->rules_, position[digits + 1]))
+    {
+      printf("Error: Invalid file: %s (line %d: %.*s)\n", path, line, (int)length, position);
+      free(deck->cards_);
+      return INVALID_FILE;
+    }
+    deck->cards_[deck->count_].value_ = value;
+    deck->cards_[deck->count_].spice_ = position[digits + 1];
+    deck->count_++;
+    position = line_end + 1;
+    line++;
+  }
+  return ALRIGHT;
+}
+
+int parseBinaryDeck(const char *path, const unsigned char *buffer, size_t size, Deck *deck)
+{
+  uint32_t count = 0;
+  uint32_t checksum = 0;
+  for(int byte = 3; byte >= 0; byte--)
+  {
+    count = count << 8 | buffer[4 + byte];
+    checksum = checksum << 8 | buffer[8 + byte];
+  }
+  if(count > size - BINARY_HEADER || deckChecksum(buffer + BINARY_HEADER, (int)count) != checksum)
+  {
+    printf("Error: Invalid file: %s\n", path);
+    return INVALID_FILE;
+  }
+  initRules(&deck->rules_);
+  const unsigned char *trailer = buffer + BINARY_HEADER + count;
+  if(size - BINARY_HEADER - count >= BINARY_RULES && memcmp(trailer, "RULE", 4) == 0)
+  {
+    deck->rules_ = (Rules){trailer[4], trailer[5], trailer[6], trailer[7], trailer[8], trailer[9]};
+    if(!checkRules(&deck->rules_))
+    {
+      printf("Error: Invalid file: %s\n", path);
+      return INVALID_FILE;
+    }
+  }
+  deck->count_ = 0;
+  deck->cards_ = malloc((count + 1) * sizeof(Card));
+  if(deck->cards_ == NULL)
+  {
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  for(uint32_t card = 0; card < count; card++)
+  {
+    int spice = buffer[BINARY_HEADER + card] >> 4;
+    int value = buffer[BINARY_HEADER + card] & 0xF;
+    if(spice >= SPICE_COUNT || value < 1 || value > MAX_VALUE || (deck->rules_.spices_ & (1 << spice)) == 0)
+    {
+      printf("Error: Invalid file: %s (card %u)\n", path, card + 1);
+      free(deck->cards_);
+      return INVALID_FILE;
+    }
+    deck->cards_[card].value_ = value;
+    deck->cards_[card].spice_ = SPICES[spice];
+  }
+  deck->count_ = (int)count;
+  return ALRIGHT;
+}
+
+uint32_t deckChecksum(const unsigned char *bytes, int count)
+{
+  uint32_t checksum = 2166136261u;
+  for(int index = 0; index < count; index++)
+  {
+    checksum = (checksum ^ bytes[index]) * 16777619u;
+  }
+  return checksum;
+}
+
+int writeBinaryDeck(const char *path, const Deck *deck)
+{
+  // the rules trailer is only written for other rules, so decks of the original game stay as they were
+  size_t size = BINARY_HEADER + deck->count_ + (customRules(&deck->rules_) ? BINARY_RULES : 0);
+  unsigned char *buffer = malloc(size);
+  if(buffer == NULL)
+  {
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  for(int card = 0; card < deck->count_; card++)
+  {
+    buffer[BINARY_HEADER + card] = (unsigned char)(spiceIndex(deck->cards_[card].spice_) << 4 |
+                                                   deck->cards_[card].value_);
+  }
+  uint32_t checksum = deckChecksum(buffer + BINARY_HEADER, deck->count_);
+  if(customRules(&deck->rules_))
+  {
+    packRules(&deck->rules_, buffer + BINARY_HEADER + deck->count_);
+  }
+  memcpy(buffer, BINARY_MAGIC, 4);
+  for(int byte = 0; byte < 4; byte++)
+  {
+    buffer[4 + byte] = (unsigned char)((uint32_t)deck->count_ >> (8 * byte));
+    buffer[8 + byte] = (unsigned char)(checksum >> (8 * byte));
+  }
+  FILE *file = fopen(path, "wb");
+  if(file == NULL)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    free(buffer);
+    return CANNOT_OPEN_FILE;
+  }
+  size_t written = fwrite(buffer, 1, size, file);
+  free(buffer);
+  if(fclose(file) != 0 || written != size)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    return CANNOT_OPEN_FILE;
+  }
+  return ALRIGHT;
+}
+
+void initRules(Rules *rules)
+{
+  *rules = (Rules){6, 2, 10, 10, 3, (1 << SPICE_COUNT) - 1};
+}
+
+bool checkRules(const Rules *rules)
+{
+  return rules->hand_size_ >= 1 && rules->hand_size_ <= CARD_KEYS && rules->penalty_ >= 0 &&
+         rules->penalty_ <= CARD_KEYS && rules->bonus_ >= 0 && rules->bonus_ <= 100 && rules->wrap_value_ >= 1 &&
+         rules->wrap_value_ <= MAX_VALUE && rules->restart_highest_ >= 1 &&
+         rules->restart_highest_ <= rules->wrap_value_ && rules->spices_ > 0 && rules->spices_ < (1 << SPICE_COUNT);
+}
+
+bool parseRules(const char *text, size_t length, Rules *rules)
+{
+  static const char *const keys[] = {"hand", "penalty", "bonus", "wrap", "restart"};
+  int *values[] = {&rules->hand_size_, &rules->penalty_, &rules->bonus_, &rules->wrap_value_, &rules->restart_highest_};
+  size_t position = 0;
+  while(position < length)
+  {
+    if(text[position] == ' ')
+    {
+      position++;
+      continue;
+    }
+    size_t end = position;
+    while(end < length && text[end] != ' ')
+    {
+      end++;
+    }
+    const char *setting = text + position;
+    const char *equals = memchr(setting, '=', end - position);
+    if(equals == NULL || equals + 1 == text + end)
+    {
+      return false;
+    }
+    size_t key_length = equals - setting;
+    const char *value = equals + 1;
+    size_t value_length = text + end - value;
+    bool known = false;
+    if(key_length == 6 && memcmp(setting, "spices", 6) == 0)
+    {
+      rules->spices_ = 0;
+      for(size_t index = 0; index < value_length; index++)
+      {
+        int spice = spiceIndex(value[index]);
+        if(spice == NO_CARD || (rules->spices_ & (1 << spice)) != 0)
+        {
+          return false;
+        }
+        rules->spices_ |= 1 << spice;
+      }
+      known = true;
+    }
+    for(int key = 0; key < 5 && !known; key++)
+    {
+      if(key_length == strlen(keys[key]) && memcmp(setting, keys[key], key_length) == 0 && value_length <= 3)
+      {
+        *values[key] = 0;
+        for(size_t index = 0; index < value_length; index++)
+        {
+          if(!isdigit((unsigned char)value[index]))
+          {
+            return false;
+          }
+          *values[key] = *values[key] * 10 + value[index] - '0';
+        }
+        known = true;
+      }
+    }
+    if(!known)
+    {
+      return false;
+    }
+    position = end;
+  }
+  return checkRules(rules);
+}
+
+void packRules(const Rules *rules, unsigned char *bytes)
+{
+  memcpy(bytes, "RULE", 4);
+  bytes[4] = (unsigned char)rules->hand_size_;
+  bytes[5] = (unsigned char)rules->penalty_;
+  bytes[6] = (unsigned char)rules->bonus_;
+  bytes[7] = (unsigned char)rules->wrap_value_;
+  bytes[8] = (unsigned char)rules->restart_highest_;
+  bytes[9] = (unsigned char)rules->spices_;
+}
+
+bool customRules(const Rules *rules)
+{
+  Rules original;
+  initRules(&original);
+  return memcmp(rules, &original, sizeof(Rules)) != 0;
+}
+
+void printRules(const Rules *rules)
+{
+  if(!customRules(rules))
+  {
+    return;
+  }
+  printf("Rules: hands of %d, %d penalty cards, %d bonus points, after %d say 1 to %d, spices ", rules->hand_size_,
+         rules->penalty_, rules->bonus_, rules->wrap_value_, rules->restart_highest_);
+  for(int spice = 0; spice < SPICE_COUNT; spice++)
+  {
+    if(rules->spices_ & (1 << spice))
+    {
+      printf("%c", SPICES[spice]);
+    }
+  }
+  printf("\n");
+}
+
+bool spiceAllowed(const Rules *rules, char spice)
+{
+  int index = spiceIndex(spice);
+  return index != NO_CARD && (rules->spices_ & (1 << index)) != 0;
+}
+
+int spiceIndex(char spice)
+{
+  const char *found = strchr(SPICES, spice);
+  return (spice == '\0' || found == NULL) ? NO_CARD : (int)(found - SPICES);
+}
+
+void moveFromStackToStack(Card *cards, Stack *stack1, Stack *stack2, int card)
+{
+  if(card == NO_CARD)
+  {
+    return;
+  }
+  removeCard(cards, stack1, card);
+  insertCardEnd(cards, stack2, card);
+}
+
+void appendStack(Card *cards, Stack *stack, Stack *other)
+{
+  if(other->first_ == NO_CARD)
+  {
+    return;
+  }
+  if(stack->last_ != NO_CARD)
+  {
+    cards[stack->last_].next_ = other->first_;
+    cards[other->first_].previous_ = stack->last_;
+  }
+  else
+  {
+    stack->first_ = other->first_;
+  }
+  stack->last_ = other->last_;
+  stack->count_ += other->count_;
+  initStack(other);
+}
+
+int cardKey(const Card *card)
+{
+  return spiceIndex(card->spice_) * MAX_VALUE + card->value_ - 1;
+}
+
+void sortStack(Card *cards, Stack *stack)
+{
+  Stack buckets[CARD_KEYS];
+  for(int key = 0; key < CARD_KEYS; key++)
+  {
+    initStack(&buckets[key]);
+  }
+  while(stack->first_ != NO_CARD)
+  {
+    int card = stack->first_;
+    moveFromStackToStack(cards, stack, &buckets[cardKey(&cards[card])], card);
+  }
+  for(int key = 0; key < CARD_KEYS; key++)
+  {
+    appendStack(cards, stack, &buckets[key]);
+  }
+}
+
+void sortHand(Card *cards, Player *player)
+{
+  sortStack(cards, &player->hand_);
+  for(int key = 0; key < CARD_KEYS; key++)
+  {
+    player->index_.count_[key] = 0;
+    player->index_.first_[key] = NO_CARD;
+  }
+  for(int card = player->hand_.last_; card != NO_CARD; card = cards[card].previous_)
+  {
+    int key = cardKey(&cards[card]);
+    player->index_.count_[key]++;
+    player->index_.first_[key] = card;
+  }
+}
+
+void moveIntoHand(Card *cards, Stack *stack, Player *player, int card)
+{
+  if(card == NO_CARD)
+  {
+    return;
+  }
+  removeCard(cards, stack, card);
+  int key = cardKey(&cards[card]);
+  // the card goes in front of the first card of the next key in the hand
+  int position = NO_CARD;
+  for(int next = key + 1; next < CARD_KEYS && position == NO_CARD; next++)
+  {
+    position = player->index_.first_[next];
+  }
+  insertCardBefore(cards, &player->hand_, card, position);
+  if(player->index_.count_[key]++ == 0)
+  {
+    player->index_.first_[key] = card;
+  }
+}
+
+void moveOutOfHand(Card *cards, Player *player, Stack *stack, int card)
+{
+  int key = cardKey(&cards[card]);
+  if(player->index_.first_[key] == card)
+  {
+    player->index_.first_[key] = player->index_.count_[key] > 1 ? cards[card].next_ : NO_CARD;
+  }
+  player->index_.count_[key]--;
+  moveFromStackToStack(cards, &player->hand_, stack, card);
+}
+
+bool inHand(const Card *cards, const Player *player, int card)
+{
+  if(card < 0)
+  {
+    return false;
+  }
+  int key = cardKey(&cards[card]);
+  int current = player->index_.first_[key];
+  for(int index = 0; index < player->index_.count_[key]; index++)
+  {
+    if(current == card)
+    {
+      return true;
+    }
+    current = cards[current].next_;
+  }
+  return false;
+}
+
+Game *createGame(const Deck *deck, int players)
+{
+  Game *game = calloc(1, sizeof(Game) + deck->count_ * sizeof(Card));
+  if(game == NULL)
+  {
+    return NULL;
+  }
+  game->rules_ = deck->rules_;
+  game->card_count_ = deck->count_;
+  game->player_count_ = players;
+  return game;
+}
+
+size_t gameSize(const Game *game)
+{
+  return sizeof(Game) + game->card_count_ * sizeof(Card);
+}
+
+uint64_t hashGame(const Game *game)
+{
+  const unsigned char *bytes = (const unsigned char *)game;
+  uint64_t hash = 14695981039346656037ULL;
+  for(size_t index = 0; index < gameSize(game); index++)
+  {
+    hash = (hash ^ bytes[index]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+bool checkGame(const Game *game)
+{
+  if(!checkRules(&game->rules_) || game->player_count_ < 2 || game->player_count_ > MAX_PLAYERS ||
+     game->current_ < 0 || game->current_ >= game->player_count_ || game->latest_played_.count_ > 1)
+  {
+    return false;
+  }
+  bool *linked = calloc(game->card_count_ + 1, sizeof(bool));
+  if(linked == NULL)
+  {
+    return false;
+  }
+  const Stack *stacks[3 + MAX_PLAYERS] = {&game->stack_, &game->discard_, &game->latest_played_};
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    stacks[3 + player] = &game->players_[player].hand_;
+  }
+  bool valid = true;
+  int total = 0;
+  for(int stack = 0; stack < 3 + game->player_count_ && valid; stack++)
+  {
+    int count = 0;
+    int previous = NO_CARD;
+    for(int card = stacks[stack]->first_; card != NO_CARD && valid; card = game->cards_[card].next_)
+    {
+      valid = card >= 0 && card < game->card_count_ && !linked[card] && game->cards_[card].previous_ == previous &&
+              spiceAllowed(&game->rules_, game->cards_[card].spice_) && game->cards_[card].value_ >= 1 &&
+              game->cards_[card].value_ <= MAX_VALUE;
+      if(valid)
+      {
+        linked[card] = true;
+        previous = card;
+        count++;
+      }
+    }
+    valid = valid && previous == stacks[stack]->last_ && count == stacks[stack]->count_;
+    total += count;
+  }
+  free(linked);
+  return valid && total == game->card_count_;
+}
+
+int saveGame(const char *path, const Game *game)
+{
+  Snapshot_header header;
+  memcpy(header.magic_, SNAPSHOT_MAGIC, 4);
+  header.game_size_ = (uint32_t)sizeof(Game);
+  header.card_size_ = (uint32_t)sizeof(Card);
+  header.card_count_ = (uint32_t)game->card_count_;
+  header.hash_ = hashGame(game);
+  FILE *file = fopen(path, "wb");
+  if(file == NULL)
+  {
+    return CANNOT_OPEN_FILE;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(game, gameSize(game), 1, file) == 1;
+  if(fclose(file) != 0 || !written)
+  {
+    return CANNOT_OPEN_FILE;
+  }
+  return ALRIGHT;
+}
+
+int loadGame(const char *path, Game *game)
+{
+  FILE *file = fopen(path, "rb");
+  if(file == NULL)
+  {
+    return CANNOT_OPEN_FILE;
+  }
+  Snapshot_header header;
+  if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic_, SNAPSHOT_MAGIC, 4) != 0 ||
+     header.game_size_ != sizeof(Game) || header.card_size_ != sizeof(Card) ||
+     header.card_count_ != (uint32_t)game->card_count_)
+  {
+    fclose(file);
+    return INVALID_FILE;
+  }
+  // read into a copy first, so the running game stays as it was if the file is broken
+  Game *loaded = malloc(gameSize(game));
+  if(loaded == NULL)
+  {
+    fclose(file);
+    return OUT_OF_MEMORY;
+  }
+  bool valid = fread(loaded, gameSize(game), 1, file) == 1 && loaded->card_count_ == game->card_count_ &&
+               loaded->player_count_ == game->player_count_ && hashGame(loaded) == header.hash_ && checkGame(loaded);
+  fclose(file);
+  if(valid)
+  {
+    memcpy(game, loaded, gameSize(game));
+    // the indexes of the hands are built again instead of trusting the file
+    for(int player = 0; player < game->player_count_; player++)
+    {
+      sortHand(game->cards_, &game->players_[player]);
+    }
+  }
+  free(loaded);
+  return valid ? ALRIGHT : INVALID_FILE;
+}
+
+void resetGame(Game *game, const Deck *deck, uint64_t *random)
+{
+  initStack(&game->stack_);
+  initStack(&game->discard_);
+  initStack(&game->latest_played_);
+  for(int card = 0; card < deck->count_; card++)
+  {
+    game->cards_[card].value_ = deck->cards_[card].value_;
+    game->cards_[card].spice_ = deck->cards_[card].spice_;
+  }
+  if(random != NULL)
+  {
+    shuffleCards(game->cards_, deck->count_, random);
+  }
+  for(int card = 0; card < deck->count_; card++)
+  {
+    insertCardEnd(game->cards_, &game->stack_, card);
+  }
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    game->players_[player].id_ = player + 1;
+    game->players_[player].points_ = 0;
+    game->players_[player].draw_last_turn = false;
+  }
+  game->current_ = 0;
+  game->said_value_ = 0;
+  game->said_spice_ = 'a';
+  game->last_card_ = false;
+  game->played_ = 0;
+  game->finished_ = false;
+  distributeCards(game);
+}
+
+void distributeCards(Game *game)
+{
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    initStack(&game->players_[player].hand_);
+  }
+  int count = 0;
+  while(game->stack_.count_ >= game->player_count_ && count < game->rules_.hand_size_)
+  {
+    for(int player = 0; player < game->player_count_; player++)
+    {
+      moveFromStackToStack(game->cards_, &game->stack_, &game->players_[player].hand_, game->stack_.first_);
+    }
+    count++;
+  }
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    sortHand(game->cards_, &game->players_[player]);
+  }
+}
+
+int findCard(const Player *player, int value, char spice)
+{
+  if(value < 1 || value > MAX_VALUE || spiceIndex(spice) == NO_CARD)
+  {
+    return NO_CARD;
+  }
+  return player->index_.first_[spiceIndex(spice) * MAX_VALUE + value - 1];
+}
+
+bool actionAllowed(const Game *game, Action_type type)
+{
+  if(type == ACTION_CHALLENGE_VALUE || type == ACTION_CHALLENGE_SPICE)
+  {
+    const Player *opponent = &game->players_[previousPlayer(game, game->current_)];
+    return game->latest_played_.first_ != NO_CARD && !opponent->draw_last_turn;
+  }
+  return !game->last_card_;
+}
+
+int nextPlayer(const Game *game, int player)
+{
+  return player + 1 < game->player_count_ ? player + 1 : 0;
+}
+
+int previousPlayer(const Game *game, int player)
+{
+  return player > 0 ? player - 1 : game->player_count_ - 1;
+}
+
+int highestOtherPoints(const Game *game, int player)
+{
+  int highest = 0;
+  bool first = true;
+  for(int other = 0; other < game->player_count_; other++)
+  {
+    if(other != player && (first || game->players_[other].points_ > highest))
+    {
+      highest = game->players_[other].points_;
+      first = false;
+    }
+  }
+  return highest;
+}
+
+int checkAction(const Game *game, const Action *action)
+{
+  if(action->type_ != ACTION_PLAY && action->type_ != ACTION_DRAW &&
+     action->type_ != ACTION_CHALLENGE_VALUE && action->type_ != ACTION_CHALLENGE_SPICE)
+  {
+    return INVALID_ACTION;
+  }
+  if(!actionAllowed(game, action->type_))
+  {
+    return NOT_ALLOWED;
+  }
+  if(action->type_ != ACTION_PLAY)
+  {
+    return ALRIGHT;
+  }
+  if(action->card_ >= game->card_count_ || !inHand(game->cards_, &game->players_[game->current_], action->card_))
+  {
+    return NOT_IN_HAND;
+  }
+  if(action->said_value_ < 1 || action->said_value_ > MAX_VALUE)
+  {
+    return INVALID_VALUE;
+  }
+  if(!spiceAllowed(&game->rules_, action->said_spice_))
+  {
+    return INVALID_SPICE;
+  }
+  int lowest;
+  int highest;
+  allowedValues(game, &lowest, &highest);
+  if(action->said_value_ < lowest || action->said_value_ > highest)
+  {
+    return INVALID_VALUE;
+  }
+  if(game->latest_played_.first_ != NO_CARD && game->said_spice_ != action->said_spice_)
+  {
+    return INVALID_SPICE;
+  }
+  return ALRIGHT;
+}
+
+bool valuesAfter(const Rules *rules, int said_value, int *lowest, int *highest)
+{
+  // no claim may pass the wrap value, so the values always start again once it is reached
+  bool restart = said_value == 0 || said_value >= rules->wrap_value_;
+  *lowest = restart ? 1 : said_value;
+  *highest = restart ? rules->restart_highest_ : rules->wrap_value_;
+  return restart;
+}
+
+void allowedValues(const Game *game, int *lowest, int *highest)
+{
+  valuesAfter(&game->rules_, game->latest_played_.first_ == NO_CARD ? 0 : game->said_value_, lowest, highest);
+}
+
+int listLegalMoves(const Game *game, Action *moves)
+{
+  int count = 0;
+  if(actionAllowed(game, ACTION_CHALLENGE_VALUE))
+  {
+    moves[count++] = (Action){ACTION_CHALLENGE_VALUE, NO_CARD, 0, 'a'};
+    moves[count++] = (Action){ACTION_CHALLENGE_SPICE, NO_CARD, 0, 'a'};
+  }
+  if(!actionAllowed(game, ACTION_PLAY))
+  {
+    return count;
+  }
+  moves[count++] = (Action){ACTION_DRAW, NO_CARD, 0, 'a'};
+  bool first = game->latest_played_.first_ == NO_CARD;
+  int lowest;
+  int highest;
+  allowedValues(game, &lowest, &highest);
+  const Hand_index *index = &game->players_[game->current_].index_;
+  for(int key = 0; key < CARD_KEYS; key++)
+  {
+    if(index->count_[key] == 0)
+    {
+      continue;
+    }
+    for(int value = lowest; value <= highest; value++)
+    {
+      for(int spice = 0; spice < SPICE_COUNT; spice++)
+      {
+        if((first && (game->rules_.spices_ & (1 << spice)) != 0) || SPICES[spice] == game->said_spice_)
+        {
+          moves[count++] = (Action){ACTION_PLAY, index->first_[key], value, SPICES[spice]};
+        }
+      }
+    }
+  }
+  return count;
+}
+
+void playCommand(Game *game, const Action *action)
+{
+  Player *player = &game->players_[game->current_];
+  game->said_value_ = action->said_value_;
+  game->said_spice_ = action->said_spice_;
+  if(game->latest_played_.first_ != NO_CARD)
+  {
+    moveFromStackToStack(game->cards_, &game->latest_played_, &game->discard_, game->latest_played_.first_);
+  }
+  moveOutOfHand(game->cards_, player, &game->latest_played_, action->card_);
+  game->played_++;
+  if(player->hand_.count_ == 0)
+  {
+    game->last_card_ = true;
+  }
+  player->draw_last_turn = false;
+}
+
+void drawAdditionalCards(Game *game, int loser, int winner)
+{
+  Stack *stack = &game->stack_;
+  int count = 0;
+  while(stack->first_ != NO_CARD && count < game->rules_.penalty_)
+  {
+    moveIntoHand(game->cards_, stack, &game->players_[loser], stack->first_);
+    count++;
+  }
+  count = 0;
+  Player *winner_player = &game->players_[winner];
+  if(winner_player->hand_.count_ == 0)
+  {
+    while(stack->first_ != NO_CARD && count < game->rules_.hand_size_)
+    {
+      moveFromStackToStack(game->cards_, stack, &winner_player->hand_, stack->first_);
+      count++;
+    }
+    sortHand(game->cards_, winner_player);
+  }
+}
+
+void challengeCommand(Game *game, const Action *action, Event *event)
+{
+  int player = game->current_;
+  int opponent = previousPlayer(game, player);
+  const Card *real_card = &game->cards_[game->latest_played_.first_];
+  event->action_.card_ = game->latest_played_.first_;
+  event->action_.said_value_ = game->said_value_;
+  event->action_.said_spice_ = game->said_spice_;
+  if(action->type_ == ACTION_CHALLENGE_VALUE)
+  {
+    event->successful_ = real_card->value_ != game->said_value_;
+  }
+  else
+  {
+    event->successful_ = real_card->spice_ != game->said_spice_;
+  }
+  int winner = event->successful_ ? player : opponent;
+  int loser = event->successful_ ? opponent : player;
+  event->winner_ = winner;
+  event->points_ = game->played_;
+  event->bonus_ = winner == opponent && game->last_card_;
+  game->players_[winner].points_ += game->played_;
+  if(event->bonus_)
+  {
+    game->players_[winner].points_ += game->rules_.bonus_;
+  }
+
+  drawAdditionalCards(game, loser, winner);
+  moveFromStackToStack(game->cards_, &game->latest_played_, &game->discard_, game->latest_played_.first_);
+  game->played_ = 0;
+  game->said_value_ = 0;
+  game->said_spice_ = 'a';
+  game->last_card_ = false;
+  game->current_ = loser;
+}
+
+void drawCommand(Game *game)
+{
+  Player *player = &game->players_[game->current_];
+  player->draw_last_turn = true;
+  moveIntoHand(game->cards_, &game->stack_, player, game->stack_.first_);
+}
+
+int doAction(Game *game, const Action *action, Event *event)
+{
+  int return_code = ALRIGHT;
+  event->type_ = EVENT_ACTION;
+  event->player_ = game->current_;
+  event->action_ = *action;
+  if(action->type_ == ACTION_PLAY)
+  {
+    playCommand(game, action);
+    game->current_ = nextPlayer(game, game->current_);
+  }
+  else if(action->type_ == ACTION_DRAW)
+  {
+    drawCommand(game);
+    game->current_ = nextPlayer(game, game->current_);
+  }
+  else
+  {
+    challengeCommand(game, action, event);
+    return_code = CHALLENGE;
+  }
+  if(game->stack_.count_ == 0)
+  {
+    game->finished_ = true;
+  }
+  return return_code;
+}
+
+void notifyAgents(const Game *game, Agent *agents, Agent *spectators, int spectator_count, const Event *event)
+{
+  for(int spectator = 0; spectator < spectator_count; spectator++)
+  {
+    spectators[spectator].observe_(game, event, spectators[spectator].context_);
+  }
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    if(agents[player].observe_ != NULL)
+    {
+      agents[player].observe_(game, event, agents[player].context_);
+    }
+  }
+}
+
+int runGame(Game *game, Agent *agents, Agent *spectators, int spectator_count)
+{
+  bool round_start = true;
+  while(!game->finished_)
+  {
+    Event event;
+    if(round_start)
+    {
+      event.type_ = EVENT_ROUND_START;
+      event.player_ = game->current_;
+      notifyAgents(game, agents, spectators, spectator_count, &event);
+      round_start = false;
+    }
+    Action action;
+    int player = game->current_;
+    int return_code = agents[player].decide_(game, player, &action, agents[player].context_);
+    if(return_code == LOADED)
+    {
+      event.type_ = EVENT_LOADED;
+      event.player_ = game->current_;
+      notifyAgents(game, agents, spectators, spectator_count, &event);
+      continue;
+    }
+    if(return_code != ALRIGHT)
+    {
+      return return_code;
+    }
+    if(checkAction(game, &action) != ALRIGHT)
+    {
+      return INVALID_ACTION;
+    }
+    if(doAction(game, &action, &event) == CHALLENGE)
+    {
+      round_start = true;
+    }
+    notifyAgents(game, agents, spectators, spectator_count, &event);
+  }
+  return ALRIGHT;
+}
+
+void printStack(const Card *cards, const Stack *stack)
+{
+  int current = stack->first_;
+  while(current != NO_CARD)
+  {
+    if(cards[current].next_ != NO_CARD)
+    {
+      printf("%d_%c ", cards[current].value_, cards[current].spice_);
+    }
+    else
+    {
+      printf("%d_%c", cards[current].value_, cards[current].spice_);
+    }
+    current = cards[current].next_;
+  }
+  printf("\n");
+}
+
+void printPlayer(const Game *game, const Player *player)
+{
+  printf("\nPlayer %d:\n", player->id_);
+  printf("    latest played card:");
+  if(game->latest_played_.first_ != NO_CARD)
+  {
+    printf(" %d_%c", game->said_value_, game->said_spice_);
+  }
+  if(game->last_card_)
+  {
+    printf(" LAST CARD");
+  }
+  printf("\n    cards played this round: %d\n", game->played_);
+  printf("    hand cards: ");
+  printStack(game->cards_, &player->hand_);
+}
+
+int getInput(Console *console, Slice *line)
+{
+  ssize_t length = getline(&console->line_, &console->capacity_, stdin);
+  if(length < 0)
+  {
+    if(feof(stdin))
+    {
+      return QUIT;
+    }
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  // like a C string the line ends at the line break or at the first null character
+  char *start = console->line_;
+  int size = 0;
+  while(size < length && start[size] != '\n' && start[size] != '\0')
+  {
+    if(start[size] >= 'A' && start[size] <= 'Z')
+    {
+      start[size] = start[size] + 32;
+    }
+    size++;
+  }
+  line->start_ = start;
+  line->length_ = size;
+  return ALRIGHT;
+}
+
+bool nextToken(Slice *rest, Slice *token)
+{
+  while(rest->length_ > 0 && *rest->start_ == ' ')
+  {
+    rest->start_++;
+    rest->length_--;
+  }
+  if(rest->length_ == 0)
+  {
+    return false;
+  }
+  token->start_ = rest->start_;
+  token->length_ = 0;
+  while(rest->length_ > 0 && *rest->start_ != ' ')
+  {
+    rest->start_++;
+    rest->length_--;
+    token->length_++;
+  }
+  return true;
+}
+
+bool tokenIs(Slice token, const char *word)
+{
+  return token.length_ == (int)strlen(word) && memcmp(token.start_, word, token.length_) == 0;
+}
+
+Command parseCommand(Slice token)
+{
+  switch(token.start_[0])
+  {
+    case 'q':
+      return tokenIs(token, "quit") ? COMMAND_QUIT : COMMAND_INVALID;
+    case 'p':
+      return tokenIs(token, "play") ? COMMAND_PLAY : COMMAND_INVALID;
+    case 'c':
+      return tokenIs(token, "challenge") ? COMMAND_CHALLENGE : COMMAND_INVALID;
+    case 'd':
+      return tokenIs(token, "draw") ? COMMAND_DRAW : COMMAND_INVALID;
+    case 's':
+      return tokenIs(token, "save") ? COMMAND_SAVE : COMMAND_INVALID;
+    case 'l':
+      return tokenIs(token, "load") ? COMMAND_LOAD : COMMAND_INVALID;
+    case 'h':
+      return tokenIs(token, "hint") ? COMMAND_HINT : COMMAND_INVALID;
+    case 'j':
+      return tokenIs(token, "join") ? COMMAND_JOIN : COMMAND_INVALID;
+    default:
+      return COMMAND_INVALID;
+  }
+}
+
+bool checkCardFormat(Slice card, int *value, char *spice)
+{
+  if(card.length_ < 3 || card.length_ > 4)
+  {
+    return false;
+  }
+  const char *underscore_pos = memchr(card.start_, '_', card.length_);
+  if(!underscore_pos)
+  {
+    return false;
+  }
+  long long value_part = underscore_pos - card.start_;
+  if(value_part < 1 || value_part > 2)
+  {
+    return false;
+  }
+  *value = 0;
+  for(int i = 0; i < value_part; i++)
+  {
+    if(!isdigit((unsigned char)card.start_[i]))
+    {
+      return false;
+    }
+    *value = *value * 10 + card.start_[i] - '0';
+  }
+  if(*value < 1 || *value > 10)
+  {
+    return false;
+  }
+
+  if(card.length_ - value_part - 1 != 1)
+  {
+    return false;
+  }
+  *spice = *(underscore_pos + 1);
+  if(*spice != 'c' && *spice != 'p' && *spice != 'w')
+  {
+    return false;
+  }
+  return true;
+}
+
+const char *actionError(int return_code)
+{
+  switch(return_code)
+  {
+    case NOT_ALLOWED:
+      return "Please enter a command you can use at the moment!";
+    case NOT_IN_HAND:
+      return "Please enter a card in your hand cards!";
+    case INVALID_VALUE:
+      return "Please enter a valid VALUE!";
+    case INVALID_SPICE:
+      return "Please enter a valid SPICE!";
+    default:
+      return "Please enter a valid command!";
+  }
+}
+
+bool checkQuit(Slice *rest)
+{
+  Slice extra;
+  if(nextToken(rest, &extra))
+  {
+    printf("Please enter the correct number of parameters!\n");
+    return false;
+  }
+  return true;
+}
+
+const char *parseAction(Command command, Slice *rest, const Game *game, Action *action)
+{
+  Slice arg1;
+  Slice arg2;
+  Slice extra;
+  int arguments = command == COMMAND_PLAY ? 2 : command == COMMAND_CHALLENGE ? 1 : 0;
+  if((arguments > 0 && !nextToken(rest, &arg1)) || (arguments > 1 && !nextToken(rest, &arg2)) ||
+     nextToken(rest, &extra))
+  {
+    return "Please enter the correct number of parameters!";
+  }
+  if(command == COMMAND_CHALLENGE)
+  {
+    if(!actionAllowed(game, ACTION_CHALLENGE_VALUE))
+    {
+      return actionError(NOT_ALLOWED);
+    }
+    if(!tokenIs(arg1, "spice") && !tokenIs(arg1, "value"))
+    {
+      return "Please choose SPICE or VALUE!";
+    }
+    action->type_ = tokenIs(arg1, "value") ? ACTION_CHALLENGE_VALUE : ACTION_CHALLENGE_SPICE;
+    return NULL;
+  }
+  if(!actionAllowed(game, ACTION_PLAY))
+  {
+    return actionError(NOT_ALLOWED);
+  }
+  if(command == COMMAND_DRAW)
+  {
+    action->type_ = ACTION_DRAW;
+    return NULL;
+  }
+  int played_value;
+  char played_spice;
+  action->type_ = ACTION_PLAY;
+  if(!checkCardFormat(arg1, &played_value, &played_spice) ||
+     !checkCardFormat(arg2, &action->said_value_, &action->said_spice_))
+  {
+    return "Please enter the cards in the correct format!";
+  }
+  action->card_ = findCard(&game->players_[game->current_], played_value, played_spice);
+  int return_code = checkAction(game, action);
+  return return_code == ALRIGHT ? NULL : actionError(return_code);
+}
+
+bool checkCommand(Command command, Slice *rest, const Game *game, Action *action)
+{
+  const char *message = parseAction(command, rest, game, action);
+  if(message != NULL)
+  {
+    printf("%s\n", message);
+  }
+  return message == NULL;
+}
+
+void checkHint(Slice *rest, const Game *game)
+{
+  Slice extra;
+  if(nextToken(rest, &extra))
+  {
+    printf("Please enter the correct number of parameters!\n");
+    return;
+  }
+  Action moves[MAX_LEGAL_MOVES];
+  int count = listLegalMoves(game, moves);
+  printf("Legal moves: %d\n", count);
+  // the plays of one card are next to each other, from the lowest to the highest thing it may be said to be
+  for(int move = 0; move < count; move++)
+  {
+    if(moves[move].type_ != ACTION_PLAY)
+    {
+      printf("    %s\n", moves[move].type_ == ACTION_DRAW ? "draw" :
+                         moves[move].type_ == ACTION_CHALLENGE_VALUE ? "challenge value" : "challenge spice");
+      continue;
+    }
+    int last = move;
+    while(last + 1 < count && moves[last + 1].card_ == moves[move].card_)
+    {
+      last++;
+    }
+    const Card *card = &game->cards_[moves[move].card_];
+    if(moves[move].said_spice_ != moves[last].said_spice_)
+    {
+      printf("    play %d_%c as %d to %d of any spice\n", card->value_, card->spice_, moves[move].said_value_,
+             moves[last].said_value_);
+    }
+    else
+    {
+      printf("    play %d_%c as %d_%c to %d_%c\n", card->value_, card->spice_, moves[move].said_value_,
+             moves[move].said_spice_, moves[last].said_value_, moves[last].said_spice_);
+    }
+    move = last;
+  }
+  // the lowest honest card keeps the most room for the next players, without one drawing is safe
+  int honest = findHonestCard(game, &game->players_[game->current_]);
+  if(honest != NO_CARD)
+  {
+    const Card *card = &game->cards_[honest];
+    printf("Hint: play %d_%c %d_%c\n", card->value_, card->spice_, card->value_, card->spice_);
+  }
+  else
+  {
+    printf("Hint: %s\n", actionAllowed(game, ACTION_DRAW) ? "draw" : "challenge value");
+  }
+}
+
+int readAndDoAction(const Game *game, int player, Action *action, void *context)
+{
+  Console *console = context;
+  printPlayer(game, &game->players_[player]);
+  while(true)
+  {
+    printf("P%d > ", game->players_[player].id_);
+    Slice rest;
+    int return_code = getInput(console, &rest);
+    if(return_code != ALRIGHT)
+    {
+      return return_code;
+    }
+    Slice token;
+    Command command = nextToken(&rest, &token) ? parseCommand(token) : COMMAND_INVALID;
+    switch(command)
+    {
+      case COMMAND_QUIT:
+        if(checkQuit(&rest))
+        {
+          return QUIT;
+        }
+        break;
+      case COMMAND_PLAY:
+      case COMMAND_CHALLENGE:
+      case COMMAND_DRAW:
+        if(checkCommand(command, &rest, game, action))
+        {
+          return ALRIGHT;
+        }
+        break;
+      case COMMAND_SAVE:
+        checkSave(&rest, game);
+        break;
+      case COMMAND_LOAD:
+        if(checkLoad(&rest, console->game_))
+        {
+          return LOADED;
+        }
+        break;
+      case COMMAND_HINT:
+        checkHint(&rest, game);
+        break;
+      default:
+        printf("Please enter a valid command!\n");
+        break;
+    }
+  }
+}
+
+void checkSave(Slice *rest, const Game *game)
+{
+  Slice arg1;
+  Slice extra;
+  if(!nextToken(rest, &arg1) || nextToken(rest, &extra))
+  {
+    printf("Please enter the correct number of parameters!\n");
+    return;
+  }
+  // the file name is followed by a space or the end of the line, which is inside the buffer
+  arg1.start_[arg1.length_] = '\0';
+  if(saveGame(arg1.start_, game) != ALRIGHT)
+  {
+    printf("Error: Cannot open file: %s\n", arg1.start_);
+  }
+  else
+  {
+    printf("Game saved to %s (%016llx).\n", arg1.start_, (unsigned long long)hashGame(game));
+  }
+}
+
+bool checkLoad(Slice *rest, Game *game)
+{
+  Slice arg1;
+  Slice extra;
+  if(!nextToken(rest, &arg1) || nextToken(rest, &extra))
+  {
+    printf("Please enter the correct number of parameters!\n");
+    return false;
+  }
+  arg1.start_[arg1.length_] = '\0';
+  int return_code = loadGame(arg1.start_, game);
+  if(return_code == CANNOT_OPEN_FILE)
+  {
+    printf("Error: Cannot open file: %s\n", arg1.start_);
+  }
+  else if(return_code == INVALID_FILE)
+  {
+    printf("Error: Invalid file: %s\n", arg1.start_);
+  }
+  else if(return_code == OUT_OF_MEMORY)
+  {
+    printf("Error: Out of memory\n");
+  }
+  else
+  {
+    printf("Game loaded from %s (%016llx).\n", arg1.start_, (unsigned long long)hashGame(game));
+  }
+  return return_code == ALRIGHT;
+}
+
+void printEvent(const Game *game, const Event *event, void *context)
+{
+  (void)context;
+  if(event->type_ == EVENT_ROUND_START)
+  {
+    printf("\n-------------------\nROUND START\n-------------------\n");
+    return;
+  }
+  if(event->type_ != EVENT_ACTION ||
+     (event->action_.type_ != ACTION_CHALLENGE_VALUE && event->action_.type_ != ACTION_CHALLENGE_SPICE))
+  {
+    return;
+  }
+  const Card *real_card = &game->cards_[event->action_.card_];
+  const char *characteristic = event->action_.type_ == ACTION_CHALLENGE_VALUE ? "value" : "spice";
+  if(event->successful_)
+  {
+    printf("Challenge successful: %d_%c's %s does not match the real card %d_%c.\n", event->action_.said_value_,
+           event->action_.said_spice_, characteristic, real_card->value_, real_card->spice_);
+  }
+  else
+  {
+    printf("Challenge failed: %d_%c's %s matches the real card %d_%c.\n", event->action_.said_value_,
+           event->action_.said_spice_, characteristic, real_card->value_, real_card->spice_);
+  }
+  const Player *winner = &game->players_[event->winner_];
+  printf("Player %d gets %d points.\n", winner->id_, event->points_);
+  if(event->bonus_)
+  {
+    printf("Player %d gets %d bonus points (last card).\n", winner->id_, game->rules_.bonus_);
+  }
+}
+
+int playingTheGame(Game *game, const Strategy *opponent, Log *log, Recorder *recorder)
+{
+  Agent agents[MAX_PLAYERS];
+  Bot bots[MAX_PLAYERS];
+  Console console = {game, NULL, 0};
+  uint64_t random = (uint64_t)time(NULL);
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    agents[player].decide_ = readAndDoAction;
+    agents[player].observe_ = NULL;
+    agents[player].context_ = &console;
+    if(opponent != NULL && player > 0)
+    {
+      initBot(&bots[player], opponent, player, nextRandom(&random));
+      agents[player].decide_ = consoleBotDecide;
+      agents[player].observe_ = botObserve;
+      agents[player].context_ = &bots[player];
+    }
+  }
+  Logger logger;
+  Agent spectators[3] = {{NULL, printEvent, NULL}};
+  int spectator_count = 1;
+  if(log != NULL)
+  {
+    uint64_t match = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid();
+    logMatchStart(&logger, log, nextRandom(&match), game, 0, opponent != NULL ? 1 + opponent->kind_ : 0);
+    spectators[spectator_count++] = (Agent){NULL, logEvent, &logger};
+  }
+  if(recorder != NULL)
+  {
+    spectators[spectator_count++] = (Agent){NULL, recordEvent, recorder};
+  }
+  int return_code = runGame(game, agents, spectators, spectator_count);
+  if(return_code == ALRIGHT && log != NULL)
+  {
+    logMatchEnd(&logger, game);
+  }
+  for(int player = 1; player < game->player_count_ && opponent != NULL; player++)
+  {
+    freeBot(&bots[player]);
+  }
+  free(console.line_);
+  return return_code;
+}
+
+void finishingTheGame(const Game *game)
+{
+  // insertion sort by points, players with equal points stay in their order
+  int order[MAX_PLAYERS];
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    int position = player;
+    while(position > 0 && game->players_[order[position - 1]].points_ < game->players_[player].points_)
+    {
+      order[position] = order[position - 1];
+      position--;
+    }
+    order[position] = player;
+  }
+  for(int position = 0; position < game->player_count_; position++)
+  {
+    const Player *player = &game->players_[order[position]];
+    printf(position == 0 ? "\nPlayer %d: %d points\n" : "Player %d: %d points\n", player->id_, player->points_);
+  }
+  int highest = game->players_[order[0]].points_;
+  for(int position = 0; position < game->player_count_ && game->players_[order[position]].points_ == highest;
+      position++)
+  {
+    printf(position == 0 ? "\nCongratulations! Player %d wins the game!\n" :
+                           "Congratulations! Player %d wins the game!\n", game->players_[order[position]].id_);
+  }
+}
+
+int openLogFile(const char *path)
+{
+  return open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+int initLog(Log *log, int file, pthread_mutex_t *lock)
+{
+  log->file_ = file;
+  log->lock_ = lock;
+  log->count_ = 0;
+  log->failed_ = false;
+  log->buffer_ = malloc(LOG_BUFFER * sizeof(Log_record));
+  return log->buffer_ == NULL ? OUT_OF_MEMORY : ALRIGHT;
+}
+
+void logRecord(Log *log, const Log_record *record)
+{
+  log->buffer_[log->count_++] = *record;
+  if(log->count_ == LOG_BUFFER)
+  {
+    flushLog(log);
+  }
+}
+
+void flushLog(Log *log)
+{
+  if(log->count_ == 0)
+  {
+    return;
+  }
+  if(log->lock_ != NULL)
+  {
+    pthread_mutex_lock(log->lock_);
+  }
+  const char *bytes = (const char *)log->buffer_;
+  size_t size = log->count_ * sizeof(Log_record);
+  while(size > 0)
+  {
+    ssize_t written = write(log->file_, bytes, size);
+    if(written <= 0)
+    {
+      log->failed_ = true;
+      break;
+    }
+    bytes += written;
+    size -= (size_t)written;
+  }
+  if(log->lock_ != NULL)
+  {
+    pthread_mutex_unlock(log->lock_);
+  }
+  log->count_ = 0;
+}
+
+bool freeLog(Log *log)
+{
+  flushLog(log);
+  free(log->buffer_);
+  return !log->failed_;
+}
+
+void logMatchStart(Logger *logger, Log *log, uint64_t match, const Game *game, int agent_1, int agent_2)
+{
+  logger->log_ = log;
+  logger->match_ = match;
+  logger->sequence_ = 0;
+  logger->agents_[0] = (uint8_t)agent_1;
+  logger->agents_[1] = (uint8_t)agent_2;
+  logger->rounds_ = 0;
+  Log_record record;
+  memset(&record, 0, sizeof(record));
+  record.match_ = match;
+  record.sequence_ = logger->sequence_++;
+  record.type_ = LOG_START;
+  record.agents_[0] = logger->agents_[0];
+  record.agents_[1] = logger->agents_[1];
+  record.points_[0] = game->card_count_;
+  record.points_[1] = game->player_count_;
+  logRecord(log, &record);
+}
+
+void logEvent(const Game *game, const Event *event, void *context)
+{
+  Logger *logger = context;
+  if(event->type_ == EVENT_ROUND_START)
+  {
+    logger->rounds_++;
+  }
+  if(event->type_ != EVENT_ACTION)
+  {
+    return;
+  }
+  Log_record record;
+  memset(&record, 0, sizeof(record));
+  record.match_ = logger->match_;
+  record.sequence_ = logger->sequence_++;
+  record.type_ = LOG_MOVE;
+  record.player_ = (uint8_t)event->player_;
+  record.action_ = (uint8_t)event->action_.type_;
+  record.agents_[0] = logger->agents_[0];
+  record.agents_[1] = logger->agents_[1];
+  record.rounds_ = (uint16_t)logger->rounds_;
+  if(event->action_.type_ != ACTION_DRAW)
+  {
+    record.said_value_ = (uint8_t)event->action_.said_value_;
+    record.said_spice_ = event->action_.said_spice_;
+    record.card_value_ = (uint8_t)game->cards_[event->action_.card_].value_;
+    record.card_spice_ = game->cards_[event->action_.card_].spice_;
+  }
+  if(event->action_.type_ == ACTION_CHALLENGE_VALUE || event->action_.type_ == ACTION_CHALLENGE_SPICE)
+  {
+    record.result_ = (uint8_t)((event->successful_ ? 1 : 0) | (event->bonus_ ? 2 : 0));
+    record.points_[0] = event->points_;
+    record.points_[1] = event->winner_;
+  }
+  logRecord(logger->log_, &record);
+}
+
+void logMatchEnd(Logger *logger, const Game *game)
+{
+  Log_record record;
+  memset(&record, 0, sizeof(record));
+  record.match_ = logger->match_;
+  record.sequence_ = logger->sequence_++;
+  record.type_ = LOG_END;
+  record.agents_[0] = logger->agents_[0];
+  record.agents_[1] = logger->agents_[1];
+  record.rounds_ = (uint16_t)logger->rounds_;
+  record.player_ = (uint8_t)game->player_count_;
+  record.points_[0] = game->players_[0].points_;
+  for(int player = 1; player < game->player_count_; player++)
+  {
+    record.points_[1] += game->players_[player].points_;
+  }
+  int difference = game->players_[0].points_ - highestOtherPoints(game, 0);
+  record.result_ = difference > 0 ? 0 : (difference < 0 ? 1 : SIDES);
+  logRecord(logger->log_, &record);
+}
+
+uint32_t packedDeckChecksum(const Deck *deck)
+{
+  uint32_t checksum = 2166136261u;
+  for(int card = 0; card < deck->count_; card++)
+  {
+    unsigned char packed = (unsigned char)(spiceIndex(deck->cards_[card].spice_) << 4 | deck->cards_[card].value_);
+    checksum = (checksum ^ packed) * 16777619u;
+  }
+  if(customRules(&deck->rules_))
+  {
+    unsigned char trailer[BINARY_RULES];
+    packRules(&deck->rules_, trailer);
+    for(int byte = 0; byte < BINARY_RULES; byte++)
+    {
+      checksum = (checksum ^ trailer[byte]) * 16777619u;
+    }
+  }
+  return checksum;
+}
+
+uint32_t scoreChecksum(const Game *game)
+{
+  uint32_t checksum = 2166136261u;
+  for(int player = 0; player < game->player_count_; player++)
+  {
+    uint32_t points = (uint32_t)game->players_[player].points_;
+    for(int byte = 0; byte < 4; byte++)
+    {
+      checksum = (checksum ^ ((points >> (8 * byte)) & 0xFF)) * 16777619u;
+    }
+  }
+  return checksum;
+}
+
+void recordEntry(Recorder *recorder, const Replay_entry *entry)
+{
+  if(recorder->count_ == recorder->capacity_)
+  {
+    int capacity = recorder->capacity_ > 0 ? 2 * recorder->capacity_ : 256;
+    Replay_entry *entries = realloc(recorder->entries_, capacity * sizeof(Replay_entry));
+    if(entries == NULL)
+    {
+      recorder->failed_ = true;
+      return;
+    }
+    recorder->entries_ = entries;
+    recorder->capacity_ = capacity;
+  }
+  recorder->entries_[recorder->count_++] = *entry;
+}
+
+void recordEvent(const Game *game, const Event *event, void *context)
+{
+  Recorder *recorder = context;
+  if(event->type_ == EVENT_LOADED)
+  {
+    recorder->loaded_ = true;
+  }
+  if(event->type_ != EVENT_ACTION)
+  {
+    return;
+  }
+  Replay_entry entry = {(uint8_t)event->action_.type_, REPLAY_NO_CARD, 0, 0, 0};
+  if(event->action_.type_ == ACTION_PLAY)
+  {
+    entry.card_ = (uint8_t)cardKey(&game->cards_[event->action_.card_]);
+    entry.said_value_ = (uint8_t)event->action_.said_value_;
+    entry.said_spice_ = (uint8_t)spiceIndex(event->action_.said_spice_);
+  }
+  else if(event->action_.type_ != ACTION_DRAW)
+  {
+    entry.scores_ = scoreChecksum(game);
+  }
+  recordEntry(recorder, &entry);
+}
+
+int writeReplay(const char *path, Recorder *recorder, const Deck *deck, uint64_t seed, bool shuffled,
+                const Game *game)
+{
+  if(recorder->loaded_)
+  {
+    return INVALID_FILE;
+  }
+  if(game->finished_)
+  {
+    // the end of the game carries the final scores
+    Replay_entry end = {REPLAY_END, REPLAY_NO_CARD, 0, 0, scoreChecksum(game)};
+    recordEntry(recorder, &end);
+  }
+  if(recorder->failed_)
+  {
+    return OUT_OF_MEMORY;
+  }
+  Replay_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic_, REPLAY_MAGIC, 4);
+  header.deck_checksum_ = packedDeckChecksum(deck);
+  header.card_count_ = (uint32_t)deck->count_;
+  header.entry_count_ = (uint32_t)recorder->count_;
+  header.seed_ = seed;
+  header.shuffled_ = shuffled;
+  header.players_ = (uint8_t)game->player_count_;
+  header.finished_ = game->finished_;
+  FILE *file = fopen(path, "wb");
+  if(file == NULL)
+  {
+    return CANNOT_OPEN_FILE;
+  }
+  // a game quit before its first action has no entries, and no buffer to write them from
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 && (recorder->count_ == 0 ||
+                 fwrite(recorder->entries_, sizeof(Replay_entry), recorder->count_, file) == (size_t)recorder->count_);
+  if(fclose(file) != 0 || !written)
+  {
+    return CANNOT_OPEN_FILE;
+  }
+  return ALRIGHT;
+}
+
+int replayGame(const char *path, const Deck *deck)
+{
+  FILE *file = fopen(path, "rb");
+  if(file == NULL)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    return CANNOT_OPEN_FILE;
+  }
+  Replay_header header;
+  if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic_, REPLAY_MAGIC, 4) != 0 ||
+     header.players_ < 2 || header.players_ > MAX_PLAYERS)
+  {
+    printf("Error: Invalid file: %s\n", path);
+    fclose(file);
+    return INVALID_FILE;
+  }
+  if(header.card_count_ != (uint32_t)deck->count_ || header.deck_checksum_ != packedDeckChecksum(deck))
+  {
+    printf("Error: Replay %s was recorded with another config\n", path);
+    fclose(file);
+    return INVALID_FILE;
+  }
+  // the entries have to fill the rest of the file exactly, so a broken count never sizes the buffer
+  struct stat status;
+  if(fstat(fileno(file), &status) != 0 || status.st_size < (off_t)sizeof(Replay_header) ||
+     (uint64_t)status.st_size - sizeof(Replay_header) != (uint64_t)header.entry_count_ * sizeof(Replay_entry))
+  {
+    printf("Error: Invalid file: %s\n", path);
+    fclose(file);
+    return INVALID_FILE;
+  }
+  Replay_entry *entries = malloc(((size_t)header.entry_count_ + 1) * sizeof(Replay_entry));
+  Game *game = createGame(deck, header.players_);
+  if(entries == NULL || game == NULL)
+  {
+    printf("Error: Out of memory\n");
+    free(entries);
+    free(game);
+    fclose(file);
+    return OUT_OF_MEMORY;
+  }
+  bool complete = fread(entries, sizeof(Replay_entry), header.entry_count_, file) == header.entry_count_;
+  fclose(file);
+  if(!complete)
+  {
+    printf("Error: Invalid file: %s\n", path);
+    free(entries);
+    free(game);
+    return INVALID_FILE;
+  }
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t random = header.seed_;
+  resetGame(game, deck, header.shuffled_ ? &random : NULL);
+  // index of the first entry which breaks the rules or does not match the recorded scores
+  uint32_t broken = header.entry_count_;
+  int rounds = 1;
+  for(uint32_t index = 0; index < header.entry_count_ && broken == header.entry_count_; index++)
+  {
+    const Replay_entry *entry = &entries[index];
+    if(entry->type_ == REPLAY_END)
+    {
+      broken = game->finished_ && index + 1 == header.entry_count_ && entry->scores_ == scoreChecksum(game) ?
+               broken : index;
+      continue;
+    }
+    Action action = {(Action_type)entry->type_, NO_CARD, entry->said_value_, 'a'};
+    if(entry->type_ == ACTION_PLAY && entry->card_ < CARD_KEYS && entry->said_spice_ < SPICE_COUNT)
+    {
+      action.card_ = findCard(&game->players_[game->current_], entry->card_ % MAX_VALUE + 1,
+                              SPICES[entry->card_ / MAX_VALUE]);
+      action.said_spice_ = SPICES[entry->said_spice_];
+    }
+    Event event;
+    if(game->finished_ || checkAction(game, &action) != ALRIGHT)
+    {
+      broken = index;
+    }
+    else if(doAction(game, &action, &event) == CHALLENGE)
+    {
+      // the round only counts once its scores match
+      broken = entry->scores_ == scoreChecksum(game) ? broken : index;
+      rounds += broken == header.entry_count_ ? 1 : 0;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double microseconds = (double)(end.tv_sec - start.tv_sec) * 1e6 + (double)(end.tv_nsec - start.tv_nsec) / 1e3;
+  int return_code = QUIT;
+  if(broken < header.entry_count_)
+  {
+    printf("Replay %s differs at action %u of %u (round %d)\n", path, broken + 1, header.entry_count_, rounds);
+    return_code = INVALID_FILE;
+  }
+  else if(header.finished_ && !game->finished_)
+  {
+    printf("Replay %s ends before the game is finished\n", path);
+    return_code = INVALID_FILE;
+  }
+  else
+  {
+    printf("Replay %s verified: %u actions, %d rounds, %s, points", path, header.entry_count_, rounds,
+           game->finished_ ? "finished" : "quit");
+    for(int player = 0; player < game->player_count_; player++)
+    {
+      printf(player == 0 ? " %d" : " : %d", game->players_[player].points_);
+    }
+    printf(" (%.1f us)\n", microseconds);
+  }
+  free(entries);
+  free(game);
+  return return_code;
+}
+
+const char *agentName(int agent)
+{
+  const char *names[STRATEGY_COUNT + 1] = {"human", "believe", "threshold", "bluff", "counting", "mcts"};
+  return agent >= 0 && agent <= STRATEGY_COUNT ? names[agent] : "unknown";
+}
+
+int queryLog(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(file == NULL)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    return CANNOT_OPEN_FILE;
+  }
+  Log_record *records = malloc(LOG_BUFFER * sizeof(Log_record));
+  if(records == NULL)
+  {
+    printf("Error: Out of memory\n");
+    fclose(file);
+    return OUT_OF_MEMORY;
+  }
+  // one tally per pair of agents, ordered by the agent of player 1
+  Tally tallies[(STRATEGY_COUNT + 1) * (STRATEGY_COUNT + 1)];
+  memset(tallies, 0, sizeof(tallies));
+  long long matches = 0;
+  long long moves = 0;
+  size_t count;
+  while((count = fread(records, sizeof(Log_record), LOG_BUFFER, file)) > 0)
+  {
+    for(size_t index = 0; index < count; index++)
+    {
+      const Log_record *record = &records[index];
+      if(record->agents_[0] > STRATEGY_COUNT || record->agents_[1] > STRATEGY_COUNT || record->type_ > LOG_END ||
+         record->player_ > MAX_PLAYERS || (record->type_ == LOG_END && record->player_ < 2))
+      {
+        printf("Error: Invalid file: %s\n", path);
+        free(records);
+        fclose(file);
+        return INVALID_FILE;
+      }
+      Tally *tally = &tallies[record->agents_[0] * (STRATEGY_COUNT + 1) + record->agents_[1]];
+      if(record->type_ == LOG_START)
+      {
+        matches++;
+      }
+      else if(record->type_ == LOG_MOVE)
+      {
+        moves++;
+        if(record->action_ == ACTION_CHALLENGE_VALUE || record->action_ == ACTION_CHALLENGE_SPICE)
+        {
+          tally->challenges_[record->player_ == 0 ? 0 : 1]++;
+          tally->successful_[record->player_ == 0 ? 0 : 1] += record->result_ & 1;
+        }
+      }
+      else
+      {
+        tally->games_++;
+        tally->seats_ += record->player_ - 1;
+        tally->rounds_ += record->rounds_;
+        tally->points_[0] += record->points_[0];
+        tally->points_[1] += record->points_[1];
+        if(record->result_ == SIDES)
+        {
+          tally->ties_++;
+        }
+        else
+        {
+          tally->wins_[record->result_ % SIDES]++;
+        }
+      }
+    }
+  }
+  free(records);
+  fclose(file);
+  long long finished = 0;
+  for(int pairing = 0; pairing < (STRATEGY_COUNT + 1) * (STRATEGY_COUNT + 1); pairing++)
+  {
+    finished += tallies[pairing].games_;
+  }
+  printf("%lld matches, %lld finished, %lld moves\n", matches, finished, moves);
+  printf("Rates are for player 1 with 95%% confidence intervals, ties count as half a win.\n\n");
+  for(int pairing = 0; pairing < (STRATEGY_COUNT + 1) * (STRATEGY_COUNT + 1); pairing++)
+  {
+    if(tallies[pairing].games_ > 0)
+    {
+      printTally(agentName(pairing / (STRATEGY_COUNT + 1)), agentName(pairing % (STRATEGY_COUNT + 1)),
+                 &tallies[pairing]);
+    }
+  }
   return QUIT;
 }
 
-//---------------------------------------------------------------------------------------------------------------------
-//functions
+int parseOptions(char **arg, int count, Options *options)
+{
+  options->tournament_games_ = 0;
+  long threads = sysconf(_SC_NPROCESSORS_ONLN);
+  options->threads_ = threads > 0 ? (int)threads : 1;
+  options->seed_ = 1;
+  options->threshold_ = 3;
+  options->bluff_percent_ = 30;
+  options->budget_ns_ = 50000;
+  options->iterations_ = 1000;
+  options->think_ns_ = 0;
+  options->players_ = 2;
+  options->log_ = NULL;
+  options->strategy_count_ = 0;
+  for(int strategy = STRATEGY_BELIEVE; strategy <= STRATEGY_COUNTING; strategy++)
+  {
+    options->strategies_[options->strategy_count_++] = strategy;
+  }
+  options->convert_ = NULL;
+  options->record_ = NULL;
+  options->replay_ = NULL;
+  options->serve_ = NULL;
+  options->tables_ = 16;
+  options->bot_ = NULL;
+  options->seeded_ = false;
+  options->shuffle_ = false;
+  options->force_ = false;
+  options->generate_ = 0;
+  for(int spice = 0; spice < SPICE_COUNT; spice++)
+  {
+    options->spice_weights_[spice] = 1;
+  }
+  for(int value = 0; value < MAX_VALUE; value++)
+  {
+    options->value_weights_[value] = 1;
+  }
+  for(int index = 2; index < count; index++)
+  {
+    if(strcmp(arg[index], "--shuffle") == 0)
+    {
+      options->shuffle_ = true;
+      continue;
+    }
+    if(strcmp(arg[index], "--force") == 0)
+    {
+      options->force_ = true;
+      continue;
+    }
+    if(index + 1 >= count)
+    {
+      printf(USAGE);
+      return INVALID_USAGE;
+    }
+    const char **path = NULL;
+    if(strcmp(arg[index], "--convert") == 0)
+    {
+      path = &options->convert_;
+    }
+    else if(strcmp(arg[index], "--log") == 0)
+    {
+      path = &options->log_;
+    }
+    else if(strcmp(arg[index], "--record") == 0)
+    {
+      path = &options->record_;
+    }
+    else if(strcmp(arg[index], "--replay") == 0)
+    {
+      path = &options->replay_;
+    }
+    else if(strcmp(arg[index], "--serve") == 0)
+    {
+      path = &options->serve_;
+    }
+    if(path != NULL)
+    {
+      *path = arg[index + 1];
+      index++;
+      continue;
+    }
+    if((strcmp(arg[index], "--spices") == 0 && parseWeights(arg[index + 1], options->spice_weights_, SPICE_COUNT)) ||
+       (strcmp(arg[index], "--values") == 0 && parseWeights(arg[index + 1], options->value_weights_, MAX_VALUE)))
+    {
+      index++;
+      continue;
+    }
+    if(strcmp(arg[index], "--bot") == 0 && strategyKind(arg[index + 1]) != NO_CARD)
+    {
+      options->bot_ = arg[index + 1];
+      index++;
+      continue;
+    }
+    if(strcmp(arg[index], "--strategies") == 0)
+    {
+      // comma separated names, each strategy at most once
+      options->strategy_count_ = 0;
+      char name[16];
+      const char *position = arg[index + 1];
+      while(true)
+      {
+        size_t length = strcspn(position, ",");
+        int kind = NO_CARD;
+        if(length < sizeof(name))
+        {
+          memcpy(name, position, length);
+          name[length] = '\0';
+          kind = strategyKind(name);
+        }
+        for(int strategy = 0; strategy < options->strategy_count_ && kind != NO_CARD; strategy++)
+        {
+          kind = options->strategies_[strategy] == kind ? NO_CARD : kind;
+        }
+        if(kind == NO_CARD)
+        {
+          printf(USAGE);
+          return INVALID_USAGE;
+        }
+        options->strategies_[options->strategy_count_++] = kind;
+        if(position[length] == '\0')
+        {
+          break;
+        }
+        position += length + 1;
+      }
+      index++;
+      continue;
+    }
+    char *end;
+    long long value = strtoll(arg[index + 1], &end, 10);
+    bool number = *arg[index + 1] != '\0' && *end == '\0';
+    if(strcmp(arg[index], "--tournament") == 0 && number && value > 0)
+    {
+      options->tournament_games_ = value;
+    }
+    else if(strcmp(arg[index], "--threads") == 0 && number && value > 0 && value <= 1024)
+    {
+      options->threads_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--seed") == 0 && number && value >= 0)
+    {
+      options->seed_ = (uint64_t)value;
+      options->seeded_ = true;
+    }
+    else if(strcmp(arg[index], "--tables") == 0 && number && value > 0 && value <= MAX_TABLES)
+    {
+      options->tables_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--generate") == 0 && number && value > 0 && value <= 100000000)
+    {
+      options->generate_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--threshold") == 0 && number && value > 0 && value <= MAX_VALUE)
+    {
+      options->threshold_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--bluff") == 0 && number && value >= 0 && value <= 100)
+    {
+      options->bluff_percent_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--budget") == 0 && number && value > 0 && value <= 1000000)
+    {
+      options->budget_ns_ = (long)value * 1000;
+    }
+    else if(strcmp(arg[index], "--iterations") == 0 && number && value > 0 && value <= 100000000)
+    {
+      options->iterations_ = (int)value;
+    }
+    else if(strcmp(arg[index], "--think") == 0 && number && value >= 0 && value <= 1000000)
+    {
+      options->think_ns_ = (long)value * 1000000;
+    }
+    else if(strcmp(arg[index], "--players") == 0 && number && value >= 2 && value <= MAX_PLAYERS)
+    {
+      options->players_ = (int)value;
+    }
+    else
+    {
+      printf(USAGE);
+      return INVALID_USAGE;
+    }
+    index++;
+  }
+  return ALRIGHT;
+}
+
+uint64_t nextRandom(uint64_t *random)
+{
+  uint64_t value = (*random += 0x9E3779B97F4A7C15ULL);
+  value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+  return value ^ (value >> 31);
+}
+
+void shuffleCards(Card *cards, int count, uint64_t *random)
+{
+  for(int index = count - 1; index > 0; index--)
+  {
+    int other = (int)(nextRandom(random) % (uint64_t)(index + 1));
+    Card temp = cards[index];
+    cards[index] = cards[other];
+    cards[other] = temp;
+  }
+}
+
+bool parseWeights(const char *text, int *weights, int count)
+{
+  long total = 0;
+  for(int index = 0; index < count; index++)
+  {
+    char *end;
+    long weight = strtol(text, &end, 10);
+    if(end == text || !isdigit((unsigned char)*text) || weight > 1000000 ||
+       *end != (index + 1 < count ? ',' : '\0'))
+    {
+      return false;
+    }
+    weights[index] = (int)weight;
+    total += weight;
+    text = end + 1;
+  }
+  return total > 0;
+}
+
+int pickWeighted(const int *weights, int count, uint64_t *random)
+{
+  uint64_t total = 0;
+  for(int index = 0; index < count; index++)
+  {
+    total += (uint64_t)weights[index];
+  }
+  uint64_t pick = nextRandom(random) % total;
+  int index = 0;
+  while(pick >= (uint64_t)weights[index])
+  {
+    pick -= (uint64_t)weights[index];
+    index++;
+  }
+  return index;
+}
+
+int generateDeck(Deck *deck, const Options *options)
+{
+  initRules(&deck->rules_);
+  deck->count_ = options->generate_;
+  deck->cards_ = malloc(deck->count_ * sizeof(Card));
+  if(deck->cards_ == NULL)
+  {
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  uint64_t random = options->seed_;
+  for(int card = 0; card < deck->count_; card++)
+  {
+    deck->cards_[card].value_ = pickWeighted(options->value_weights_, MAX_VALUE, &random) + 1;
+    deck->cards_[card].spice_ = SPICES[pickWeighted(options->spice_weights_, SPICE_COUNT, &random)];
+  }
+  return ALRIGHT;
+}
+
+int writeTextDeck(const char *path, const Deck *deck, bool replace)
+{
+  // "ESP\n" and at most 5 characters per card, written with one call
+  char *buffer = malloc(4 + 5 * (size_t)deck->count_);
+  if(buffer == NULL)
+  {
+    printf("Error: Out of memory\n");
+    return OUT_OF_MEMORY;
+  }
+  memcpy(buffer, "ESP\n", 4);
+  size_t size = 4;
+  for(int card = 0; card < deck->count_; card++)
+  {
+    if(deck->cards_[card].value_ == 10)
+    {
+      buffer[size++] = '1';
+      buffer[size++] = '0';
+    }
+    else
+    {
+      buffer[size++] = (char)('0' + deck->cards_[card].value_);
+    }
+    buffer[size++] = '_';
+    buffer[size++] = deck->cards_[card].spice_;
+    buffer[size++] = '\n';
+  }
+  // exclusive mode, so a config which is already there is never truncated by accident
+  FILE *file = fopen(path, replace ? "w" : "wx");
+  if(file == NULL && errno == EEXIST)
+  {
+    printf("Error: %s already exists, add --force to replace it\n", path);
+    free(buffer);
+    return CANNOT_OPEN_FILE;
+  }
+  if(file == NULL)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    free(buffer);
+    return CANNOT_OPEN_FILE;
+  }
+  size_t written = fwrite(buffer, 1, size, file);
+  free(buffer);
+  if(fclose(file) != 0 || written != size)
+  {
+    printf("Error: Cannot open file: %s\n", path);
+    return CANNOT_OPEN_FILE;
+  }
+  return ALRIGHT;
+}
+
+int findHonestCard(const Game *game, const Player *player)
+{
+  bool first = game->latest_played_.first_ == NO_CARD;
+  int lowest;
+  int highest;
+  allowedValues(game, &lowest, &highest);
+  for(int value = lowest; value <= highest; value++)
+  {
+    for(int spice = 0; spice < SPICE_COUNT; spice++)
+    {
+      int key = spice * MAX_VALUE + value - 1;
+      if((first || SPICES[spice] == game->said_spice_) && player->index_.count_[key] > 0)
+      {
+        return player->index_.first_[key];
+      }
+    }
+  }
+  return NO_CARD;
+}
+
+void initStrategies(Strategy *strategies, const Options *options)
+{
+  strategies[STRATEGY_BELIEVE] = (Strategy){STRATEGY_BELIEVE, "believe", 0, 0, 0, 0, 1};
+  strategies[STRATEGY_THRESHOLD] = (Strategy){STRATEGY_THRESHOLD, "threshold", options->threshold_, 0, 0, 0, 1};
+  strategies[STRATEGY_BLUFF] =
+    (Strategy){STRATEGY_BLUFF, "bluff", options->threshold_, options->bluff_percent_, 0, 0, 1};
+  strategies[STRATEGY_COUNTING] = (Strategy){STRATEGY_COUNTING, "counting", 0, 0, options->budget_ns_, 0, 1};
+  strategies[STRATEGY_MCTS] =
+    (Strategy){STRATEGY_MCTS, "mcts", 0, 0, options->think_ns_, options->iterations_, options->threads_};
+}
+
+int strategyKind(const char *name)
+{
+  const char *names[STRATEGY_COUNT] = {"believe", "threshold", "bluff", "counting", "mcts"};
+  for(int kind = 0; kind < STRATEGY_COUNT; kind++)
+  {
+    if(strcmp(name, names[kind]) == 0)
+    {
+      return kind;
+    }
+  }
+  return NO_CARD;
+}
+
+void initBot(Bot *bot, const Strategy *strategy, int player, uint64_t seed)
+{
+  bot->strategy_ = strategy;
+  bot->player_ = player;
+  bot->random_ = seed;
+  bot->previous_said_ = 0;
+  bot->last_said_ = 0;
+  bot->counting_ = false;
+  bot->searches_ = NULL;
+}
+
+void freeBot(Bot *bot)
+{
+  if(bot->searches_ == NULL)
+  {
+    return;
+  }
+  for(int search = 0; search < bot->strategy_->threads_; search++)
+  {
+    free(bot->searches_[search].simulation_);
+    free(bot->searches_[search].nodes_);
+    free(bot->searches_[search].path_);
+    free(bot->searches_[search].hidden_);
+  }
+  free(bot->searches_);
+  bot->searches_ = NULL;
+}
+
+void markSeen(Bot *bot, const Game *game, int card)
+{
+  if(card == NO_CARD || card >= COUNTING_CARDS)
+  {
+    return;
+  }
+  uint64_t bit = 1ULL << (card % 64);
+  if((bot->seen_[card / 64] & bit) == 0)
+  {
+    bot->seen_[card / 64] |= bit;
+    bot->unseen_[cardKey(&game->cards_[card])]--;
+    bot->unseen_count_--;
+  }
+}
+
+double missProbability(int unseen, int marked, int draws)
+{
+  double probability = 1.0;
+  for(int draw = 0; draw < draws && draw < unseen; draw++)
+  {
+    if(unseen - marked - draw <= 0)
+    {
+      return 0.0;
+    }
+    probability *= (double)(unseen - marked - draw) / (double)(unseen - draw);
+  }
+  return probability;
+}
+
+double lieProbability(const Bot *bot, const Game *game)
+{
+  // the opponent had to lie or draw if none of its cards could be played honestly, a claim of a card which
+  // cannot be in its hand any more is a lie for sure
+  int spice = spiceIndex(game->said_spice_);
+  Card said = {game->said_value_, game->said_spice_, NO_CARD, NO_CARD};
+  int lowest;
+  int highest;
+  valuesAfter(&game->rules_, bot->previous_said_, &lowest, &highest);
+  int playable = 0;
+  for(int other = 0; other < SPICE_COUNT; other++)
+  {
+    for(int value = lowest; value <= highest && (other == spice || bot->previous_said_ == 0); value++)
+    {
+      playable += bot->unseen_[other * MAX_VALUE + value - 1];
+    }
+  }
+  int opponent_cards = game->players_[previousPlayer(game, bot->player_)].hand_.count_;
+  double forced = missProbability(bot->unseen_count_, playable, opponent_cards + 1);
+  return bot->unseen_[cardKey(&said)] == 0 ? 1.0 : forced * BLUFF_PRIOR / (forced * BLUFF_PRIOR + 1 - forced);
+}
 
-Card *insertCardEnd(Card *stack, int value, char spice)
+int countingDecide(const Game *game, Action *action, Bot *bot)
 {
-  Card *new = malloc(sizeof(Card));
-  if(new == NULL)
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  const Player *player = &game->players_[bot->player_];
+  const Stack *hand = &player->hand_;
+  int opponent_cards = game->players_[nextPlayer(game, bot->player_)].hand_.count_;
+  for(int card = hand->first_; card != NO_CARD; card = game->cards_[card].next_)
   {
-    printf("Error: Out of memory\n");
-    return NULL;
+    markSeen(bot, game, card);
+  }
+  int honest = findHonestCard(game, player);
+  if(actionAllowed(game, ACTION_CHALLENGE_VALUE))
+  {
+    int spice = spiceIndex(game->said_spice_);
+    double lie = lieProbability(bot, game);
+    // without an honest card the bot would have to draw or bluff, which makes challenging cheaper
+    if(!actionAllowed(game, ACTION_PLAY) || lie > 0.5 || (honest == NO_CARD && lie > 0.35))
+    {
+      int same_value = 0;
+      int same_spice = 0;
+      for(int other = 0; other < SPICE_COUNT; other++)
+      {
+        same_value += bot->unseen_[other * MAX_VALUE + game->said_value_ - 1];
+      }
+      for(int value = 0; value < MAX_VALUE; value++)
+      {
+        same_spice += bot->unseen_[spice * MAX_VALUE + value];
+      }
+      // a lying card matches the said spice or value about as often as the unseen cards do
+      action->type_ = same_spice < same_value ? ACTION_CHALLENGE_SPICE : ACTION_CHALLENGE_VALUE;
+      return ALRIGHT;
+    }
+  }
+  if(honest != NO_CARD)
+  {
+    bool first = game->latest_played_.first_ == NO_CARD;
+    int lowest;
+    int highest;
+    allowedValues(game, &lowest, &highest);
+    double best_answer = 2.0;
+    for(int card = hand->first_; card != NO_CARD; card = game->cards_[card].next_)
+    {
+      const Card *candidate = &game->cards_[card];
+      if(candidate->value_ < lowest || candidate->value_ > highest ||
+         (!first && candidate->spice_ != game->said_spice_))
+      {
+        continue;
+      }
+      // chance that the opponent holds a card to answer this claim honestly
+      int spice = spiceIndex(candidate->spice_);
+      int answers = 0;
+      int answer_lowest;
+      int answer_highest;
+      valuesAfter(&game->rules_, candidate->value_, &answer_lowest, &answer_highest);
+      for(int value = answer_lowest; value <= answer_highest; value++)
+      {
+        answers += bot->unseen_[spice * MAX_VALUE + value - 1];
+      }
+      double answer = 1.0 - missProbability(bot->unseen_count_, answers, opponent_cards);
+      if(answer < best_answer)
+      {
+        best_answer = answer;
+        honest = card;
+      }
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) >= bot->strategy_->budget_ns_)
+      {
+        break;
+      }
+    }
+    action->type_ = ACTION_PLAY;
+    action->card_ = honest;
+    action->said_value_ = game->cards_[honest].value_;
+    action->said_spice_ = game->cards_[honest].spice_;
+    return ALRIGHT;
+  }
+  // a bluff is only made while few points are at stake and the said card could still be in the hand
+  bool first = game->latest_played_.first_ == NO_CARD;
+  if(hand->count_ > 0 && game->played_ < 3)
+  {
+    int lowest;
+    int highest;
+    allowedValues(game, &lowest, &highest);
+    Card said = {lowest, first ? game->cards_[hand->last_].spice_ : game->said_spice_, NO_CARD, NO_CARD};
+    if(bot->unseen_[cardKey(&said)] > 0)
+    {
+      action->type_ = ACTION_PLAY;
+      action->card_ = hand->last_;
+      action->said_value_ = said.value_;
+      action->said_spice_ = said.spice_;
+      return ALRIGHT;
+    }
   }
-  new->value_ = value;
-  new->spice_ = spice;
-  new->next_ = NULL;
-  if(stack == NULL)
+  action->type_ = ACTION_DRAW;
+  return ALRIGHT;
+}
+
+int listMoves(const Game *game, Action *moves)
+{
+  int count = 0;
+  if(actionAllowed(game, ACTION_CHALLENGE_VALUE))
+  {
+    moves[count++] = (Action){ACTION_CHALLENGE_VALUE, NO_CARD, 0, 'a'};
+    moves[count++] = (Action){ACTION_CHALLENGE_SPICE, NO_CARD, 0, 'a'};
+  }
+  if(!actionAllowed(game, ACTION_PLAY))
   {
-    return new;
+    return count;
   }
-  Card *current = stack;
-  while(current->next_ != NULL)
+  moves[count++] = (Action){ACTION_DRAW, NO_CARD, 0, 'a'};
+  bool first = game->latest_played_.first_ == NO_CARD;
+  int lowest;
+  int highest;
+  allowedValues(game, &lowest, &highest);
+  const Hand_index *index = &game->players_[game->current_].index_;
+  for(int key = 0; key < CARD_KEYS; key++)
   {
-    current = current->next_;
+    if(index->count_[key] == 0)
+    {
+      continue;
+    }
+    int card = index->first_[key];
+    const Card *real_card = &game->cards_[card];
+    Action *move = &moves[count++];
+    move->type_ = ACTION_PLAY;
+    move->card_ = card;
+    if(real_card->value_ >= lowest && real_card->value_ <= highest && (first || real_card->spice_ == game->said_spice_))
+    {
+      move->said_value_ = real_card->value_;
+      move->said_spice_ = real_card->spice_;
+    }
+    else
+    {
+      move->said_value_ = lowest;
+      move->said_spice_ = first ? real_card->spice_ : game->said_spice_;
+    }
   }
-  current->next_ = new;
-  return stack;
+  return count;
 }
 
-int checkCommandLine(char **arg, int count, Card **stack)
+int moveKey(const Game *game, const Action *move, int observer)
 {
-  if(count < 2)
+  if(move->type_ != ACTION_PLAY)
   {
-    printf("Usage: ./a4-csf <config file>\n");
-    return INVALID_USAGE;
+    return move->type_;
   }
-  FILE *file = fopen(arg[1], "r");
-  if(file == NULL)
+  int key = ACTION_PLAY | move->said_value_ << 4 | spiceIndex(move->said_spice_) << 8;
+  if(game->current_ == observer)
   {
-    printf("Error: Cannot open file: %s\n", arg[1]);
-    return CANNOT_OPEN_FILE;
+    key |= (cardKey(&game->cards_[move->card_]) + 1) << 12;
   }
-  char magic_number[5];
-  fgets(magic_number, sizeof(magic_number), file);
-  if(strcmp(magic_number, "ESP\n") != 0)
+  return key;
+}
+
+void determinize(Search *search)
+{
+  Game *simulation = search->simulation_;
+  const Bot *bot = search->bot_;
+  memcpy(simulation, search->game_, search->game_size_);
+  // the other hands, the main stack, the face down played card and the discarded cards the bot never saw
+  int hidden = 0;
+  Stack *stacks[MAX_PLAYERS + 1];
+  Player *players[MAX_PLAYERS];
+  int hands = 0;
+  for(int player = 0; player < simulation->player_count_; player++)
   {
-    printf("Error: Invalid file: %s\n", arg[1]);
-    fclose(file);
-    return INVALID_FILE;
+    if(player != bot->player_)
+    {
+      players[hands] = &simulation->players_[player];
+      stacks[hands++] = &simulation->players_[player].hand_;
+    }
+  }
+  stacks[hands] = &simulation->stack_;
+  stacks[hands + 1] = &simulation->latest_played_;
+  for(int stack = 0; stack < hands + 2; stack++)
+  {
+    for(int card = stacks[stack]->first_; card != NO_CARD; card = simulation->cards_[card].next_)
+    {
+      search->hidden_[hidden++] = card;
+    }
+  }
+  for(int card = simulation->discard_.first_; card != NO_CARD; card = simulation->cards_[card].next_)
+  {
+    if(card < COUNTING_CARDS && (bot->seen_[card / 64] & (1ULL << (card % 64))) == 0)
+    {
+      search->hidden_[hidden++] = card;
+    }
+  }
+  for(int index = hidden - 1; index > 0; index--)
+  {
+    int other = (int)(nextRandom(&search->random_) % (uint64_t)(index + 1));
+    Card *card = &simulation->cards_[search->hidden_[index]];
+    Card *other_card = &simulation->cards_[search->hidden_[other]];
+    int value = card->value_;
+    char spice = card->spice_;
+    card->value_ = other_card->value_;
+    card->spice_ = other_card->spice_;
+    other_card->value_ = value;
+    other_card->spice_ = spice;
+  }
+  // the face down card is the said one unless the claim was a lie
+  int latest = simulation->latest_played_.first_;
+  if(latest != NO_CARD && (double)(nextRandom(&search->random_) % 1000) >= 1000 * search->lie_)
+  {
+    for(int index = 0; index < hidden; index++)
+    {
+      Card *card = &simulation->cards_[search->hidden_[index]];
+      if(card->value_ == simulation->said_value_ && card->spice_ == simulation->said_spice_)
+      {
+        card->value_ = simulation->cards_[latest].value_;
+        card->spice_ = simulation->cards_[latest].spice_;
+        simulation->cards_[latest].value_ = simulation->said_value_;
+        simulation->cards_[latest].spice_ = simulation->said_spice_;
+        break;
+      }
+    }
+  }
+  for(int player = 0; player < hands; player++)
+  {
+    sortHand(simulation->cards_, players[player]);
+  }
+}
+
+int playoutMove(const Game *game, Action *moves, int count, uint64_t *random)
+{
+  if(nextRandom(random) % 100 < PLAYOUT_RANDOM)
+  {
+    return (int)(nextRandom(random) % (uint64_t)count);
+  }
+  int honest = findHonestCard(game, &game->players_[game->current_]);
+  for(int move = 0; move < count; move++)
+  {
+    if((moves[move].type_ == ACTION_PLAY && moves[move].card_ == honest && honest != NO_CARD) ||
+       (moves[move].type_ == ACTION_DRAW && honest == NO_CARD) ||
+       (moves[move].type_ == ACTION_CHALLENGE_VALUE && !actionAllowed(game, ACTION_PLAY)))
+    {
+      return move;
+    }
+  }
+  return 0;
+}
+
+double gameResult(const Game *game, int player)
+{
+  int points = game->players_[player].points_;
+  int other = highestOtherPoints(game, player);
+  return points > other ? 1.0 : (points == other ? 0.5 : 0.0);
+}
+
+void *searchThread(void *argument)
+{
+  Search *search = argument;
+  Game *simulation = search->simulation_;
+  int observer = search->bot_->player_;
+  Node *nodes = search->nodes_;
+  nodes[0] = (Node){0, NO_CARD, NO_CARD, NO_CARD, 0, 0, 0.0};
+  search->node_count_ = 1;
+  Action moves[MAX_MOVES];
+  Event event;
+  for(int iteration = 0; iteration < search->iterations_; iteration++)
+  {
+    if(search->deadline_.tv_sec != 0 && (iteration & 15) == 0)
+    {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if(now.tv_sec > search->deadline_.tv_sec ||
+         (now.tv_sec == search->deadline_.tv_sec && now.tv_nsec >= search->deadline_.tv_nsec))
+      {
+        break;
+      }
+    }
+    determinize(search);
+    int node = 0;
+    int depth = 0;
+    search->path_[depth++] = 0;
+    // selection among the children whose moves are possible in this determinization, then expansion
+    while(!simulation->finished_)
+    {
+      int count = listMoves(simulation, moves);
+      int untried[MAX_MOVES];
+      int untried_count = 0;
+      int best = NO_CARD;
+      int best_move = NO_CARD;
+      double best_score = -1.0;
+      for(int move = 0; move < count; move++)
+      {
+        int key = moveKey(simulation, &moves[move], observer);
+        int child = nodes[node].first_child_;
+        while(child != NO_CARD && nodes[child].move_ != key)
+        {
+          child = nodes[child].next_sibling_;
+        }
+        if(child == NO_CARD)
+        {
+          untried[untried_count++] = move;
+          continue;
+        }
+        nodes[child].available_++;
+        double score = nodes[child].wins_ / nodes[child].visits_ +
+                       EXPLORATION * sqrt(log((double)nodes[child].available_) / nodes[child].visits_);
+        if(score > best_score)
+        {
+          best_score = score;
+          best = child;
+          best_move = move;
+        }
+      }
+      if(untried_count > 0 && search->node_count_ < search->node_capacity_)
+      {
+        int move = untried[nextRandom(&search->random_) % (uint64_t)untried_count];
+        int child = search->node_count_++;
+        nodes[child] = (Node){moveKey(simulation, &moves[move], observer), simulation->current_, NO_CARD,
+                              nodes[node].first_child_, 0, 1, 0.0};
+        nodes[node].first_child_ = child;
+        doAction(simulation, &moves[move], &event);
+        search->path_[depth++] = child;
+        break;
+      }
+      if(best == NO_CARD)
+      {
+        break;
+      }
+      doAction(simulation, &moves[best_move], &event);
+      node = best;
+      search->path_[depth++] = node;
+    }
+    // playout to the end of the game
+    while(!simulation->finished_)
+    {
+      int count = listMoves(simulation, moves);
+      if(count == 0)
+      {
+        break;
+      }
+      doAction(simulation, &moves[playoutMove(simulation, moves, count, &search->random_)], &event);
+    }
+    double result = gameResult(simulation, observer);
+    for(int index = 0; index < depth; index++)
+    {
+      Node *visited = &nodes[search->path_[index]];
+      visited->visits_++;
+      visited->wins_ += visited->player_ == observer ? result : 1.0 - result;
+    }
+  }
+  return NULL;
+}
+
+int mctsDecide(const Game *game, Action *action, Bot *bot)
+{
+  Action moves[MAX_MOVES];
+  int count = listMoves(game, moves);
+  if(count == 1)
+  {
+    *action = moves[0];
+    return ALRIGHT;
+  }
+  for(int card = game->players_[bot->player_].hand_.first_; card != NO_CARD; card = game->cards_[card].next_)
+  {
+    markSeen(bot, game, card);
   }
-  int value;
-  char spice;
-  while(fscanf(file, "%d_%c\n", &value, &spice) == 2)
+  const Strategy *strategy = bot->strategy_;
+  if(bot->searches_ == NULL)
   {
-    *stack = insertCardEnd(*stack, value, spice);
-    if(*stack == NULL)
+    bot->searches_ = calloc(strategy->threads_, sizeof(Search));
+    if(bot->searches_ == NULL)
     {
       return OUT_OF_MEMORY;
     }
+    // every iteration adds at most one node to the tree of its thread
+    int capacity = strategy->iterations_ / strategy->threads_ + 2;
+    for(int index = 0; index < strategy->threads_; index++)
+    {
+      Search *search = &bot->searches_[index];
+      search->game_size_ = gameSize(game);
+      search->simulation_ = malloc(search->game_size_);
+      search->nodes_ = malloc(capacity * sizeof(Node));
+      search->path_ = malloc((capacity + 1) * sizeof(int));
+      search->hidden_ = malloc((game->card_count_ + 1) * sizeof(int));
+      search->node_capacity_ = capacity;
+      if(search->simulation_ == NULL || search->nodes_ == NULL || search->path_ == NULL || search->hidden_ == NULL)
+      {
+        freeBot(bot);
+        return OUT_OF_MEMORY;
+      }
+    }
   }
-  fclose(file);
+  struct timespec deadline = {0, 0};
+  if(strategy->budget_ns_ > 0)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += (deadline.tv_nsec + strategy->budget_ns_) / 1000000000L;
+    deadline.tv_nsec = (deadline.tv_nsec + strategy->budget_ns_) % 1000000000L;
+  }
+  for(int index = 0; index < strategy->threads_; index++)
+  {
+    Search *search = &bot->searches_[index];
+    search->bot_ = bot;
+    search->game_ = game;
+    search->random_ = nextRandom(&bot->random_);
+    search->lie_ = game->latest_played_.first_ != NO_CARD ? lieProbability(bot, game) : 0.0;
+    search->iterations_ = strategy->iterations_ / strategy->threads_ +
+                          (index < strategy->iterations_ % strategy->threads_ ? 1 : 0);
+    search->deadline_ = deadline;
+  }
+  // root parallelization: every thread searches its own tree, the visits of the root moves are added up
+  int started = 1;
+  while(started < strategy->threads_ &&
+        pthread_create(&bot->searches_[started].thread_, NULL, searchThread, &bot->searches_[started]) == 0)
+  {
+    started++;
+  }
+  searchThread(&bot->searches_[0]);
+  for(int index = 1; index < started; index++)
+  {
+    pthread_join(bot->searches_[index].thread_, NULL);
+  }
+  int best = 0;
+  long best_visits = -1;
+  for(int move = 0; move < count; move++)
+  {
+    int key = moveKey(game, &moves[move], bot->player_);
+    long visits = 0;
+    for(int index = 0; index < started; index++)
+    {
+      const Node *nodes = bot->searches_[index].nodes_;
+      for(int child = nodes[0].first_child_; child != NO_CARD; child = nodes[child].next_sibling_)
+      {
+        visits += nodes[child].move_ == key ? nodes[child].visits_ : 0;
+      }
+    }
+    if(visits > best_visits)
+    {
+      best_visits = visits;
+      best = move;
+    }
+  }
+  *action = moves[best];
   return ALRIGHT;
 }
 
-void moveFromStackToStack(Card **stack1, Card **stack2, Card *card)
+int consoleBotDecide(const Game *game, int player, Action *action, void *context)
 {
-  Card *current = *stack1;
-  Card *previous = NULL;
-  while(current != NULL)
+  int return_code = botDecide(game, player, action, context);
+  printf("\nP%d > ", game->players_[player].id_);
+  if(action->type_ == ACTION_PLAY)
   {
-    if(current == card)
+    printf("play ?_? %d_%c\n", action->said_value_, action->said_spice_);
+  }
+  else if(action->type_ == ACTION_DRAW)
+  {
+    printf("draw\n");
+  }
+  else
+  {
+    printf("challenge %s\n", action->type_ == ACTION_CHALLENGE_VALUE ? "value" : "spice");
+  }
+  return return_code;
+}
+
+int botDecide(const Game *game, int player, Action *action, void *context)
+{
+  Bot *bot = context;
+  const Strategy *strategy = bot->strategy_;
+  if(strategy->kind_ == STRATEGY_COUNTING)
+  {
+    return countingDecide(game, action, bot);
+  }
+  if(strategy->kind_ == STRATEGY_MCTS)
+  {
+    return mctsDecide(game, action, bot);
+  }
+  if(actionAllowed(game, ACTION_CHALLENGE_VALUE))
+  {
+    // after the wrap value the said values start again, so the jump is not suspicious
+    int lowest;
+    int highest;
+    int jump = valuesAfter(&game->rules_, bot->previous_said_, &lowest, &highest) ?
+               0 : game->said_value_ - bot->previous_said_;
+    if(!actionAllowed(game, ACTION_PLAY) ||
+       (strategy->kind_ != STRATEGY_BELIEVE && jump >= strategy->threshold_))
     {
-      break;
+      action->type_ = ACTION_CHALLENGE_VALUE;
+      return ALRIGHT;
     }
-    previous = current;
-    current = current->next_;
   }
-  if(current != NULL)
+  const Stack *hand = &game->players_[player].hand_;
+  int card = findHonestCard(game, &game->players_[player]);
+  if(card != NO_CARD)
+  {
+    action->type_ = ACTION_PLAY;
+    action->card_ = card;
+    action->said_value_ = game->cards_[card].value_;
+    action->said_spice_ = game->cards_[card].spice_;
+    return ALRIGHT;
+  }
+  if(strategy->kind_ == STRATEGY_BLUFF && hand->count_ > 0 &&
+     (int)(nextRandom(&bot->random_) % 100) < strategy->bluff_percent_)
+  {
+    // gets rid of the highest card and says the lowest value allowed
+    bool first = game->latest_played_.first_ == NO_CARD;
+    int lowest;
+    int highest;
+    allowedValues(game, &lowest, &highest);
+    action->type_ = ACTION_PLAY;
+    action->card_ = hand->last_;
+    action->said_value_ = lowest;
+    action->said_spice_ = first ? game->cards_[hand->last_].spice_ : game->said_spice_;
+    return ALRIGHT;
+  }
+  action->type_ = ACTION_DRAW;
+  return ALRIGHT;
+}
+
+void botObserve(const Game *game, const Event *event, void *context)
+{
+  Bot *bot = context;
+  if(event->type_ == EVENT_LOADED)
+  {
+    // only the cards in the hand of the loaded game are known
+    bot->counting_ = false;
+  }
+  if((bot->strategy_->kind_ == STRATEGY_COUNTING || bot->strategy_->kind_ == STRATEGY_MCTS) && !bot->counting_)
   {
-    if(previous != NULL)
+    // the composition of the deck is known to everyone, only the order is hidden
+    memset(bot->seen_, 0, sizeof(bot->seen_));
+    memset(bot->unseen_, 0, sizeof(bot->unseen_));
+    for(int card = 0; card < game->card_count_; card++)
     {
-      previous->next_ = current->next_;
+      bot->unseen_[cardKey(&game->cards_[card])]++;
     }
-    else
+    bot->unseen_count_ = game->card_count_;
+    bot->counting_ = true;
+  }
+  if(event->type_ == EVENT_ROUND_START)
+  {
+    bot->previous_said_ = 0;
+    bot->last_said_ = 0;
+  }
+  else if(event->type_ == EVENT_LOADED)
+  {
+    bot->previous_said_ = 0;
+    bot->last_said_ = game->latest_played_.first_ != NO_CARD ? game->said_value_ : 0;
+  }
+  else if(event->action_.type_ == ACTION_PLAY)
+  {
+    bot->previous_said_ = bot->last_said_;
+    bot->last_said_ = event->action_.said_value_;
+  }
+  else if(event->action_.type_ != ACTION_DRAW && bot->counting_)
+  {
+    markSeen(bot, game, event->action_.card_);
+  }
+}
+
+void tallyEvent(const Game *game, const Event *event, void *context)
+{
+  (void)game;
+  Tally *tally = context;
+  if(event->type_ == EVENT_ROUND_START)
+  {
+    tally->rounds_++;
+  }
+  else if(event->type_ == EVENT_ACTION &&
+          (event->action_.type_ == ACTION_CHALLENGE_VALUE || event->action_.type_ == ACTION_CHALLENGE_SPICE))
+  {
+    int side = event->player_ == 0 ? 0 : 1;
+    tally->challenges_[side]++;
+    if(event->successful_)
     {
-      *stack1 = current->next_;
+      tally->successful_[side]++;
     }
-    current->next_ = NULL;
-    if(*stack2 == NULL)
+  }
+}
+
+void *tournamentThread(void *argument)
+{
+  Worker *worker = argument;
+  Tournament *tournament = worker->tournament_;
+  long long total = tournament->games_ * tournament->chosen_count_ * tournament->chosen_count_;
+  Game *game = createGame(tournament->deck_, tournament->players_);
+  Log log;
+  bool logging = tournament->log_file_ >= 0;
+  if(game == NULL || (logging && initLog(&log, tournament->log_file_, &tournament->log_lock_) != ALRIGHT))
+  {
+    free(game);
+    worker->status_ = OUT_OF_MEMORY;
+    return NULL;
+  }
+  Logger logger;
+  while(true)
+  {
+    long long start = atomic_fetch_add(&tournament->next_game_, TOURNAMENT_CHUNK);
+    if(start >= total)
     {
-      *stack2 = current;
-      return;
+      break;
     }
-    Card *stack2_current = *stack2;
-    while(stack2_current->next_ != NULL)
+    long long end = start + TOURNAMENT_CHUNK < total ? start + TOURNAMENT_CHUNK : total;
+    for(long long index = start; index < end; index++)
     {
-      stack2_current = stack2_current->next_;
+      int pairing = (int)(index / tournament->games_);
+      Tally *tally = &worker->tallies_[pairing];
+      // every game has its own seed so the results do not depend on the number of threads
+      uint64_t random = tournament->seed_ ^ ((uint64_t)index * 0xD6E8FEB86659FD93ULL);
+      resetGame(game, tournament->deck_, &random);
+      Bot bots[MAX_PLAYERS];
+      Agent agents[MAX_PLAYERS];
+      for(int player = 0; player < game->player_count_; player++)
+      {
+        int strategy = tournament->chosen_[player == 0 ? pairing / tournament->chosen_count_ :
+                                                         pairing % tournament->chosen_count_];
+        initBot(&bots[player], &tournament->strategies_[strategy], player, nextRandom(&random));
+        agents[player].decide_ = botDecide;
+        agents[player].observe_ = botObserve;
+        agents[player].context_ = &bots[player];
+      }
+      Agent spectators[2] = {{NULL, tallyEvent, tally}, {NULL, logEvent, &logger}};
+      if(logging)
+      {
+        uint64_t match = tournament->seed_ ^ (uint64_t)index;
+        logMatchStart(&logger, &log, nextRandom(&match), game, 1 + bots[0].strategy_->kind_,
+                      1 + bots[1].strategy_->kind_);
+      }
+      int return_code = runGame(game, agents, spectators, logging ? 2 : 1);
+      if(return_code == ALRIGHT && logging)
+      {
+        logMatchEnd(&logger, game);
+      }
+      for(int player = 0; player < game->player_count_; player++)
+      {
+        freeBot(&bots[player]);
+      }
+      if(return_code != ALRIGHT)
+      {
+        tally->errors_++;
+        continue;
+      }
+      tally->games_++;
+      tally->seats_ += game->player_count_ - 1;
+      int points_1 = game->players_[0].points_;
+      int points_2 = highestOtherPoints(game, 0);
+      tally->points_[0] += points_1;
+      for(int player = 1; player < game->player_count_; player++)
+      {
+        tally->points_[1] += game->players_[player].points_;
+      }
+      if(points_1 == points_2)
+      {
+        tally->ties_++;
+      }
+      else
+      {
+        tally->wins_[points_1 > points_2 ? 0 : 1]++;
+      }
     }
-    stack2_current->next_ = current;
   }
+  if(logging && !freeLog(&log))
+  {
+    worker->status_ = CANNOT_OPEN_FILE;
+  }
+  free(game);
+  return NULL;
 }
 
-void sortStackByValue(Card **stack)
+int runTournament(const Deck *deck, const Options *options)
 {
-  Card *new_stack = NULL;
-
-  Card *current = *stack;
-  while(current != NULL)
+  Tournament tournament;
+  tournament.deck_ = deck;
+  initStrategies(tournament.strategies_, options);
+  // the threads of the tournament play games, so each search runs on the thread of its game
+  tournament.strategies_[STRATEGY_MCTS].threads_ = 1;
+  tournament.chosen_ = options->strategies_;
+  tournament.chosen_count_ = options->strategy_count_;
+  int pairings = options->strategy_count_ * options->strategy_count_;
+  tournament.games_ = options->tournament_games_;
+  tournament.seed_ = options->seed_;
+  tournament.players_ = options->players_;
+  atomic_init(&tournament.next_game_, 0);
+  tournament.log_file_ = -1;
+  if(options->log_ != NULL)
   {
-    Card *next = current->next_;
-    current->next_ = NULL;
-    if(new_stack == NULL || current->value_ < new_stack->value_)
+    tournament.log_file_ = openLogFile(options->log_);
+    if(tournament.log_file_ < 0)
     {
-      current->next_ = new_stack;
-      new_stack = current;
+      printf("Error: Cannot open file: %s\n", options->log_);
+      return CANNOT_OPEN_FILE;
     }
-    else
+    pthread_mutex_init(&tournament.log_lock_, NULL);
+  }
+  Worker *workers = calloc(options->threads_, sizeof(Worker));
+  if(workers == NULL)
+  {
+    printf("Error: Out of memory\n");
+    if(tournament.log_file_ >= 0)
+    {
+      close(tournament.log_file_);
+      pthread_mutex_destroy(&tournament.log_lock_);
+    }
+    return OUT_OF_MEMORY;
+  }
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  int started = 0;
+  for(int index = 0; index < options->threads_; index++)
+  {
+    workers[index].tournament_ = &tournament;
+    workers[index].status_ = ALRIGHT;
+  }
+  while(started < options->threads_ &&
+        pthread_create(&workers[started].thread_, NULL, tournamentThread, &workers[started]) == 0)
+  {
+    started++;
+  }
+  // without any thread the games are played on the main thread
+  int used = started > 0 ? started : 1;
+  if(started == 0)
+  {
+    tournamentThread(&workers[0]);
+  }
+  Tally tallies[STRATEGY_COUNT * STRATEGY_COUNT];
+  memset(tallies, 0, sizeof(tallies));
+  int return_code = QUIT;
+  for(int index = 0; index < used; index++)
+  {
+    if(started > 0)
+    {
+      pthread_join(workers[index].thread_, NULL);
+    }
+    if(workers[index].status_ == OUT_OF_MEMORY)
+    {
+      return_code = OUT_OF_MEMORY;
+    }
+    else if(workers[index].status_ == CANNOT_OPEN_FILE && return_code == QUIT)
+    {
+      return_code = CANNOT_OPEN_FILE;
+    }
+    for(int pairing = 0; pairing < pairings; pairing++)
     {
-      Card *new_stack_current = new_stack;
-      while(new_stack_current->next_ != NULL && new_stack_current->next_->value_ < current->value_)
+      const Tally *from = &workers[index].tallies_[pairing];
+      Tally *to = &tallies[pairing];
+      to->games_ += from->games_;
+      to->errors_ += from->errors_;
+      to->ties_ += from->ties_;
+      to->rounds_ += from->rounds_;
+      to->seats_ += from->seats_;
+      for(int player = 0; player < SIDES; player++)
       {
-        new_stack_current = new_stack_current->next_;
+        to->wins_[player] += from->wins_[player];
+        to->points_[player] += from->points_[player];
+        to->challenges_[player] += from->challenges_[player];
+        to->successful_[player] += from->successful_[player];
       }
-      current->next_ = new_stack_current->next_;
-      new_stack_current->next_ = current;
     }
-    current = next;
   }
-  *stack = new_stack;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(workers);
+  if(tournament.log_file_ >= 0)
+  {
+    close(tournament.log_file_);
+    pthread_mutex_destroy(&tournament.log_lock_);
+  }
+  if(return_code == OUT_OF_MEMORY)
+  {
+    printf("Error: Out of memory\n");
+    return return_code;
+  }
+  if(return_code == CANNOT_OPEN_FILE)
+  {
+    printf("Warning: Results not written to file!\n");
+    return_code = QUIT;
+  }
+  double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  long long games = tournament.games_ * pairings;
+  printf("Tournament: %d pairings x %lld games on %d threads in %.2f s (%.0f games/s)\n",
+         pairings, tournament.games_, used, seconds, seconds > 0 ? (double)games / seconds : 0.0);
+  printf("Strategies: believe, threshold (jump %d), bluff (jump %d, %d%% lies), counting (%ld us per move), "
+         "mcts (%d iterations)\n", options->threshold_, options->threshold_, options->bluff_percent_,
+         options->budget_ns_ / 1000, options->iterations_);
+  printRules(&deck->rules_);
+  if(tournament.players_ > 2)
+  {
+    printf("Tables of %d players: player 1 against %d players of the second strategy, whose points are averaged.\n",
+           tournament.players_, tournament.players_ - 1);
+  }
+  printf("Rates are for player 1 with 95%% confidence intervals, ties count as half a win.\n\n");
+  for(int pairing = 0; pairing < pairings; pairing++)
+  {
+    printTally(tournament.strategies_[tournament.chosen_[pairing / tournament.chosen_count_]].name_,
+               tournament.strategies_[tournament.chosen_[pairing % tournament.chosen_count_]].name_, &tallies[pairing]);
+  }
+  return QUIT;
 }
 
-void sortStack(Card **stack)
+void printTally(const char *first, const char *second, const Tally *tally)
 {
-  Card *c = NULL;
-  Card *p = NULL;
-  Card *w = NULL;
-
-  Card *current = *stack;
-  while(current != NULL)
+  printf("%-9s vs %-9s:", first, second);
+  if(tally->games_ == 0)
   {
-    Card *next = current->next_;
-    if(current->spice_ == 'c')
-    {
-      moveFromStackToStack(stack, &c, current);
-    }
-    if(current->spice_ == 'p')
+    printf(" no games finished (%lld errors)\n", tally->errors_);
+    return;
+  }
+  double games = (double)tally->games_;
+  // score of a game is 1, 0.5 or 0, its variance gives the interval of the mean
+  double win_rate = ((double)tally->wins_[0] + 0.5 * (double)tally->ties_) / games;
+  double squares = ((double)tally->wins_[0] + 0.25 * (double)tally->ties_) / games;
+  double variance = squares - win_rate * win_rate;
+  double interval = 1.96 * sqrt((variance > 0 ? variance : 0) / games);
+  printf(" wins %5.1f%% +- %.1f%%, ties %4.1f%%, points %5.1f : %-5.1f, rounds %4.1f", 100 * win_rate,
+         100 * interval, 100 * (double)tally->ties_ / games, (double)tally->points_[0] / games,
+         (double)tally->points_[1] / (double)tally->seats_, (double)tally->rounds_ / games);
+  printf(", challenges won");
+  for(int player = 0; player < SIDES; player++)
+  {
+    if(tally->challenges_[player] == 0)
     {
-      moveFromStackToStack(stack, &p, current);
+      printf(" -");
     }
-    if(current->spice_ == 'w')
+    else
     {
-      moveFromStackToStack(stack, &w, current);
+      double challenges = (double)tally->challenges_[player];
+      double rate = (double)tally->successful_[player] / challenges;
+      printf(" %.1f%% +- %.1f%%", 100 * rate, 100 * 1.96 * sqrt(rate * (1 - rate) / challenges));
     }
-    current = next;
+    printf(player == 0 ? " :" : "");
   }
-  sortStackByValue(&c);
-  sortStackByValue(&p);
-  sortStackByValue(&w);
-
-  current = c;
-  while(current != NULL)
+  if(tally->errors_ > 0)
   {
-    Card *next = current->next_;
-    moveFromStackToStack(&c, stack, current);
-    current = next;
+    printf(", %lld errors", tally->errors_);
   }
-  current = p;
-  while(current != NULL)
+  printf("\n");
+}
+
+void sendText(int client, const char *text, size_t length)
+{
+  if(send(client, text, length, MSG_NOSIGNAL) != (ssize_t)length)
   {
-    Card *next = current->next_;
-    moveFromStackToStack(&p, stack, current);
-    current = next;
+    shutdown(client, SHUT_RDWR);
   }
-  current = w;
-  while(current != NULL)
+}
+
+void sendClient(Server *server, int client, const char *format, ...)
+{
+  va_list arguments;
+  va_start(arguments, format);
+  int length = vsnprintf(server->reply_, server->reply_size_, format, arguments);
+  va_end(arguments);
+  if(length >= 0)
   {
-    Card *next = current->next_;
-    moveFromStackToStack(&w, stack, current);
-    current = next;
+    sendText(client, server->reply_, (size_t)length < server->reply_size_ ? (size_t)length : server->reply_size_ - 1);
   }
 }
 
-void distributeCards(Card **stack, Player *player_1, Player *player_2)
+void sendTable(Server *server, const Table *table, const char *text)
 {
-  player_1->hand_ = NULL;
-  player_1->id_ = 1;
-  player_2->hand_ = NULL;
-  player_2->id_ = 2;
-  int count = 0;
-  Card *current = *stack;
-  while(current != NULL)
-  {
-    Card *card_1 = current;
-    Card *card_2 = current->next_;
-    Card *next = card_2->next_;
-    moveFromStackToStack(stack, &player_1->hand_, card_1);
-    moveFromStackToStack(stack, &player_2->hand_, card_2);
-    count++;
-    if(count == 6)
+  for(int seat = 0; seat < server->players_; seat++)
+  {
+    if(table->seats_[seat] >= 0)
     {
-      break;
+      sendText(table->seats_[seat], text, strlen(text));
     }
-    current = next;
   }
-  sortStack(&player_1->hand_);
-  sortStack(&player_2->hand_);
 }
 
-void printStack(Card *stack)
+void sendTurn(Server *server, const Table *table)
 {
-  Card *current = stack;
-  while(current != NULL)
+  const Game *game = table->game_;
+  const Player *player = &game->players_[game->current_];
+  char *reply = server->reply_;
+  size_t size = server->reply_size_;
+  int length = snprintf(reply, size, "turn P%d latest ", player->id_);
+  if(game->latest_played_.first_ != NO_CARD)
   {
-    if(current->next_ != NULL)
-    {
-      printf("%d_%c ", current->value_, current->spice_);
-    }
-    else
-    {
-      printf("%d_%c", current->value_, current->spice_);
-    }
-    current = current->next_;
+    length += snprintf(reply + length, size - length, "%d_%c", game->said_value_, game->said_spice_);
   }
-  printf("\n");
+  else
+  {
+    length += snprintf(reply + length, size - length, "-");
+  }
+  length += snprintf(reply + length, size - length, "%s played %d hand", game->last_card_ ? " LAST CARD" : "",
+                     game->played_);
+  // the reply buffer has room for every card of the deck
+  for(int card = player->hand_.first_; card != NO_CARD; card = game->cards_[card].next_)
+  {
+    length += snprintf(reply + length, size - length, " %d_%c", game->cards_[card].value_, game->cards_[card].spice_);
+  }
+  length += snprintf(reply + length, size - length, "\n");
+  sendText(table->seats_[game->current_], reply, (size_t)length);
 }
 
-void printPlayer(Player *player, bool last_card, int played, int said_value, char said_spice, Card *latest_played)
+void sendEvent(Server *server, const Table *table, const Event *event)
 {
-  printf("\nPlayer %d:\n", player->id_);
-  printf("    latest played card:");
-  if(latest_played != NULL)
+  const Game *game = table->game_;
+  const Action *action = &event->action_;
+  char text[128];
+  int id = game->players_[event->player_].id_;
+  if(action->type_ == ACTION_PLAY)
   {
-    printf(" %d_%c", said_value, said_spice);
+    snprintf(text, sizeof(text), "P%d play %d_%c\n", id, action->said_value_, action->said_spice_);
   }
-  if(last_card)
+  else if(action->type_ == ACTION_DRAW)
   {
-    printf(" LAST CARD");
+    snprintf(text, sizeof(text), "P%d draw\n", id);
   }
-  printf("\n    cards played this round: %d\n", played);
-  printf("    hand cards: ");
-  printStack(player->hand_);
+  else
+  {
+    const Card *real_card = &game->cards_[action->card_];
+    snprintf(text, sizeof(text), "P%d challenge %s %s %d_%c P%d +%d", id,
+             action->type_ == ACTION_CHALLENGE_VALUE ? "value" : "spice", event->successful_ ? "successful" : "failed",
+             real_card->value_, real_card->spice_, game->players_[event->winner_].id_, event->points_);
+    if(event->bonus_)
+    {
+      snprintf(text + strlen(text), sizeof(text) - strlen(text), " +%d", game->rules_.bonus_);
+    }
+    snprintf(text + strlen(text), sizeof(text) - strlen(text), "\n");
+  }
+  sendTable(server, table, text);
 }
 
-char *getInput(void)
+void closeTable(Server *server, Table *table, const char *reason)
 {
-  int size = 10;
-  char *buffer = malloc(size * sizeof(char));
-  if(buffer == NULL)
+  char text[32 + MAX_PLAYERS * 16];
+  int length = snprintf(text, sizeof(text), "end %s", reason);
+  for(int player = 0; player < server->players_ && table->playing_; player++)
   {
-    printf("Error: Out of memory\n");
-    return NULL;
+    length += snprintf(text + length, sizeof(text) - length, " P%d %d", table->game_->players_[player].id_,
+                       table->game_->players_[player].points_);
   }
-  int index = 0;
-  char input;
-  while((input = getchar()) != '\n')
+  snprintf(text + length, sizeof(text) - length, "\n");
+  sendTable(server, table, text);
+  for(int seat = 0; seat < server->players_; seat++)
   {
-    buffer[index] = input;
-    index++;
-    if(index == size - 1)
+    int client = table->seats_[seat];
+    if(client >= 0)
     {
-      size = size * 2;
-      char *temp = realloc(buffer, size * sizeof(char));
-      if(temp == NULL)
-      {
-        free(buffer);
-        printf("Error: Out of memory\n");
-        return NULL;
-      }
-      buffer = temp;
+      server->clients_[client].open_ = false;
+      server->clients_[client].table_ = NO_CARD;
+      close(client);
+      table->seats_[seat] = NO_CARD;
     }
   }
-  buffer[index] = '\0';
-  for(unsigned long i = 0; i < strlen(buffer); i++)
+  table->seated_ = 0;
+  table->playing_ = false;
+}
+
+void dropClient(Server *server, int client)
+{
+  Client *connection = &server->clients_[client];
+  if(connection->table_ != NO_CARD)
   {
-    if(buffer[i] >= 'A' && buffer[i] <= 'Z')
+    Table *table = &server->tables_[connection->table_];
+    table->seats_[connection->seat_] = NO_CARD;
+    table->seated_--;
+    if(table->playing_)
     {
-      buffer[i] = buffer[i] + 32;
+      char reason[32];
+      snprintf(reason, sizeof(reason), "left P%d", connection->seat_ + 1);
+      closeTable(server, table, reason);
     }
   }
-  return buffer;
+  connection->open_ = false;
+  connection->table_ = NO_CARD;
+  close(client);
 }
 
-bool checkCardFormat(char *card, int *value, char *spice)
+void joinTable(Server *server, int client, Slice *rest)
 {
-  if(strlen(card) < 3 || strlen(card) > 4)
+  Client *connection = &server->clients_[client];
+  Slice number;
+  Slice extra;
+  int table_number = 0;
+  if(!nextToken(rest, &number) || nextToken(rest, &extra))
   {
-    return false;
+    sendClient(server, client, "error Please enter the correct number of parameters!\n");
+    return;
   }
-  char *underscore_pos = strchr(card, '_');
-  if(!underscore_pos)
+  for(int digit = 0; digit < number.length_ && digit < 5; digit++)
   {
-    return false;
+    table_number = isdigit((unsigned char)number.start_[digit]) ? table_number * 10 + number.start_[digit] - '0' : 0;
   }
-  long long value_part = underscore_pos - card;
-  if(value_part < 1 || value_part > 2)
+  if(table_number < 1 || table_number > server->table_count_)
   {
-    return false;
+    sendClient(server, client, "error Please enter a table from 1 to %d!\n", server->table_count_);
+    return;
   }
-  for(int i = 0; i < value_part; i++)
+  if(connection->table_ != NO_CARD)
   {
-    if(!isdigit(card[i]))
-    {
-      return false;
-    }
+    sendClient(server, client, "error You are already seated!\n");
+    return;
   }
-  *value = atoi(card);
-  if(*value < 1 || *value > 10)
+  Table *table = &server->tables_[table_number - 1];
+  if(table->playing_)
   {
-    return false;
+    sendClient(server, client, "error The table is full!\n");
+    return;
   }
-
-  if(strlen(underscore_pos + 1) != 1)
+  int seat = 0;
+  while(table->seats_[seat] != NO_CARD)
   {
-    return false;
+    seat++;
   }
-  *spice = *(underscore_pos + 1);
-  if(*spice != 'c' && *spice != 'p' && *spice != 'w')
+  table->seats_[seat] = client;
+  table->seated_++;
+  connection->table_ = table_number - 1;
+  connection->seat_ = seat;
+  sendClient(server, client, "seated %d P%d\n", table_number, seat + 1);
+  if(table->seated_ < server->players_)
   {
-    return false;
+    return;
   }
-  return true;
-}
-
-Card *findCard(Card *stack, int value, char spice)
-{
-  Card *current = stack;
-  while(current != NULL)
+  // the game block of a table is allocated for its first game and used again by all later ones
+  if(table->game_ == NULL)
   {
-    if(current->value_ == value && current->spice_ == spice)
+    table->game_ = createGame(server->deck_, server->players_);
+    if(table->game_ == NULL)
     {
-      return current;
+      closeTable(server, table, "out of memory");
+      return;
     }
-    current = current->next_;
   }
-  return NULL;
+  resetGame(table->game_, server->deck_, server->shuffle_ ? &server->random_ : NULL);
+  table->playing_ = true;
+  sendTable(server, table, "start\n");
+  sendTurn(server, table);
 }
 
-bool playCommand(char *arg1, char *arg2, Player *player, Card **latest_played, int *said_value, char *said_spice,
-                 bool *last_card, Card **discard, int *played)
+void handleLine(Server *server, int client, Slice line)
 {
-  int new_said_value;
-  char new_said_spice;
-  int played_value;
-  char played_spice;
-  if(!checkCardFormat(arg1, &played_value, &played_spice) ||
-     !checkCardFormat(arg2, &new_said_value, &new_said_spice))
+  Client *connection = &server->clients_[client];
+  Slice token;
+  Command command = nextToken(&line, &token) ? parseCommand(token) : COMMAND_INVALID;
+  if(command == COMMAND_JOIN)
   {
-    printf("Please enter the cards in the correct format!\n");
-    return false;
+    joinTable(server, client, &line);
+    return;
   }
-  Card *played_card = findCard(player->hand_, played_value, played_spice);
-  if(played_card == NULL)
+  if(command == COMMAND_QUIT)
   {
-    printf("Please enter a card in your hand cards!\n");
-    return false;
+    dropClient(server, client);
+    return;
   }
-  if(*latest_played != NULL)
+  if(command != COMMAND_PLAY && command != COMMAND_CHALLENGE && command != COMMAND_DRAW)
   {
-    if((*said_value != 10 && *said_value > new_said_value) || (*said_value == 10 && new_said_value > 3))
-    {
-      printf("Please enter a valid VALUE!\n");
-      return false;
-    }
-    if(*said_spice != new_said_spice)
-    {
-      printf("Please enter a valid SPICE!\n");
-      return false;
-    }
+    sendClient(server, client, "error Please enter a valid command!\n");
+    return;
   }
-  else
+  Table *table = connection->table_ != NO_CARD ? &server->tables_[connection->table_] : NULL;
+  if(table == NULL || !table->playing_ || table->game_->current_ != connection->seat_)
   {
-    if(new_said_value > 3)
-    {
-      printf("Please enter a valid VALUE!\n");
-      return false;
-    }
+    sendClient(server, client, "error %s\n", actionError(NOT_ALLOWED));
+    return;
   }
-  *said_value = new_said_value;
-  *said_spice = new_said_spice;
-  if(*latest_played != NULL)
+  Action action;
+  const char *message = parseAction(command, &line, table->game_, &action);
+  if(message != NULL)
   {
-    moveFromStackToStack(latest_played, discard, *latest_played);
+    sendClient(server, client, "error %s\n", message);
+    return;
   }
-  moveFromStackToStack(&player->hand_, latest_played, played_card);
-  (*played)++;
-  if(player->hand_ == NULL)
+  Event event;
+  doAction(table->game_, &action, &event);
+  sendEvent(server, table, &event);
+  if(table->game_->finished_)
   {
-    *last_card = true;
+    closeTable(server, table, "finished");
+    return;
   }
-
-  return true;
+  sendTurn(server, table);
 }
 
-void drawAdditionalCards(Player *loser, Player *winner, Card **stack)
+void readClient(Server *server, int client)
 {
-  int count = 0;
-  Card *current = *stack;
-  while(current != NULL)
+  Client *connection = &server->clients_[client];
+  // the client may have been closed with its table by an event handled before in the same batch
+  if(!connection->open_)
   {
-    Card *next_card = current->next_;
-    moveFromStackToStack(stack, &loser->hand_, current);
-    count++;
-    if(count == 2)
-    {
-      break;
-    }
-    current = next_card;
+    return;
   }
-  count = 0;
-  if(winner->hand_ == NULL)
+  ssize_t received = recv(client, connection->line_ + connection->length_,
+                          CLIENT_LINE - connection->length_, 0);
+  if(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
   {
-    current = *stack;
-    while(current != NULL)
-    {
-      Card *next_card = current->next_;
-      moveFromStackToStack(stack, &winner->hand_, current);
-      count++;
-      if(count == 6)
-      {
-        break;
-      }
-      current = next_card;
-    }
+    return;
   }
-  sortStack(&loser->hand_);
-  sortStack(&winner->hand_);
-}
-
-bool challengeCommand(char *arg1, Player *player, Player *opponent, Card **latest_played, int *said_value,
-                      char *said_spice, bool *last_card, Card **discard, Card **stack, int *played)
-{
-  Player *winner;
-  Player *loser;
-  if(strcmp(arg1, "spice") != 0 && strcmp(arg1, "value") != 0)
+  if(received <= 0)
   {
-    printf("Please choose SPICE or VALUE!\n");
-    return false;
+    dropClient(server, client);
+    return;
   }
-  if(strcmp(arg1, "value") == 0)
+  connection->length_ += (int)received;
+  int start = 0;
+  for(int position = 0; position < connection->length_; position++)
   {
-    if((*latest_played)->value_ != *said_value)
+    char *character = &connection->line_[position];
+    *character = (*character >= 'A' && *character <= 'Z') ? (char)(*character + 32) : *character;
+    if(*character != '\n')
     {
-      printf("Challenge successful: %d_%c's value does not match the real card %d_%c.\n",
-             *said_value, *said_spice, (*latest_played)->value_, (*latest_played)->spice_);
-      winner = player;
-      loser = opponent;
-    }
-    else
-    {
-      printf("Challenge failed: %d_%c's value matches the real card %d_%c.\n",
-             *said_value, *said_spice, (*latest_played)->value_, (*latest_played)->spice_);
-      winner = opponent;
-      loser = player;
+      continue;
     }
-  }
-  if(strcmp(arg1, "spice") == 0)
-  {
-    if((*latest_played)->spice_ != *said_spice)
+    // a line may end the game of the table and close this client, then the rest of its data is dropped
+    Slice line = {connection->line_ + start, position - start};
+    if(line.length_ > 0 && line.start_[line.length_ - 1] == '\r')
     {
-      printf("Challenge successful: %d_%c's spice does not match the real card %d_%c.\n",
-             *said_value, *said_spice, (*latest_played)->value_, (*latest_played)->spice_);
-      winner = player;
-      loser = opponent;
+      line.length_--;
     }
-    else
+    start = position + 1;
+    handleLine(server, client, line);
+    if(!connection->open_)
     {
-      printf("Challenge failed: %d_%c's spice matches the real card %d_%c.\n",*said_value,
-             *said_spice, (*latest_played)->value_, (*latest_played)->spice_);
-      winner = opponent;
-      loser = player;
+      return;
     }
   }
-  printf("Player %d gets %d points.\n", winner->id_, *played);
-  winner->points_ += *played;
-  if(winner == opponent && *last_card)
+  connection->length_ -= start;
+  memmove(connection->line_, connection->line_ + start, connection->length_);
+  if(connection->length_ == CLIENT_LINE)
   {
-    printf("Player %d gets 10 bonus points (last card).\n", winner->id_);
-    winner->points_ += 10;
+    sendClient(server, client, "error Line too long!\n");
+    dropClient(server, client);
   }
-
-  drawAdditionalCards(loser, winner, stack);
-  moveFromStackToStack(latest_played, discard, *latest_played);
-  *played = 0;
-  *said_value = 0;
-  *said_spice = 'a';
-  *last_card = false;
-  loser->round_loser = true;
-  return true;
-}
-
-void drawCommand(Player *player, Card **stack)
-{
-  player->draw_last_turn = true;
-  moveFromStackToStack(stack, &player->hand_, *stack);
-  sortStack(&player->hand_);
 }
 
-bool checkQuit(char *input)
+void acceptClients(Server *server)
 {
-  if(strtok(NULL," ") != NULL)
+  while(true)
   {
-    printf("Please enter the correct number of parameters!\n");
-    free(input);
-    return false;
+    int client = accept(server->listener_, NULL, NULL);
+    if(client < 0)
+    {
+      return;
+    }
+    if(client >= server->client_capacity_ || fcntl(client, F_SETFL, O_NONBLOCK) < 0)
+    {
+      close(client);
+      continue;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = client};
+    if(epoll_ctl(server->epoll_, EPOLL_CTL_ADD, client, &event) < 0)
+    {
+      close(client);
+      continue;
+    }
+    server->clients_[client] = (Client){true, NO_CARD, 0, 0, {0}};
+    sendClient(server, client, "spice %d tables %d players\n", server->table_count_, server->players_);
   }
-  free(input);
-  return true;
 }
 
-bool checkPlay(char *input, Player *player, Card **latest_played, int *said_value, char *said_spice,
-               bool *last_card, Card **discard, int *played)
+int runServer(const Deck *deck, const Options *options)
 {
-  char *arg1 = strtok(NULL, " ");
-  char *arg2 = strtok(NULL, " ");
-
-  if(arg1 == NULL || arg2 == NULL || strtok(NULL," ") != NULL)
+  Server server = {deck, options->players_, options->shuffle_, options->seed_, NULL, options->tables_, NULL, 0, -1,
+                   -1, NULL, 0};
+  if(!options->seeded_)
   {
-    printf("Please enter the correct number of parameters!\n");
-    free(input);
-    return false;
-  }
-  if(*last_card)
-  {
-    printf("Please enter a command you can use at the moment!\n");
-    free(input);
-    return false;
-  }
-  if(!playCommand(arg1, arg2, player, latest_played, said_value, said_spice, last_card, discard,played))
-  {
-    free(input);
-    return false;
+    server.random_ = ((uint64_t)time(NULL) << 32) ^ (uint64_t)getpid();
   }
-  player->draw_last_turn = false;
-  free(input);
-  return true;
-}
-
-bool checkChallenge(char *input, Player *player, Player *opponent, Card **latest_played, int *said_value,
-                    char *said_spice, bool *last_card, Card **discard, Card **stack, int *played)
-{
-  char *arg1 = strtok(NULL, " ");
-  if(arg1 == NULL || strtok(NULL, " ") != NULL)
+  // one socket per seat, the listener, the epoll instance and the standard streams
+  server.client_capacity_ = options->tables_ * options->players_ + 16;
+  server.reply_size_ = (size_t)deck->count_ * 5 + 128;
+  server.tables_ = malloc(sizeof(Table) * options->tables_);
+  server.clients_ = malloc(sizeof(Client) * server.client_capacity_);
+  server.reply_ = malloc(server.reply_size_);
+  if(server.tables_ == NULL || server.clients_ == NULL || server.reply_ == NULL)
   {
-    printf("Please enter the correct number of parameters!\n");
-    free(input);
-    return false;
+    printf("Error: Out of memory\n");
+    free(server.tables_);
+    free(server.clients_);
+    free(server.reply_);
+    return OUT_OF_MEMORY;
   }
-  if(*latest_played == NULL || opponent->draw_last_turn == true)
+  for(int table = 0; table < options->tables_; table++)
   {
-    printf("Please enter a command you can use at the moment!\n");
-    free(input);
-    return false;
+    server.tables_[table] = (Table){NULL, {0}, 0, false};
+    for(int seat = 0; seat < MAX_PLAYERS; seat++)
+    {
+      server.tables_[table].seats_[seat] = NO_CARD;
+    }
   }
-  if(!challengeCommand(arg1, player, opponent, latest_played, said_value, said_spice, last_card, discard, stack, played))
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  struct stat status;
+  if(strlen(options->serve_) < sizeof(address.sun_path) && lstat(options->serve_, &status) == 0 &&
+     !S_ISSOCK(status.st_mode))
   {
-    free(input);
-    return false;
+    printf("Error: %s exists and is not a socket\n", options->serve_);
   }
-  free(input);
-  return true;
-}
-
-bool checkDraw(char *input, Player *player, Card **stack, bool *last_card)
-{
-  if(strtok(NULL, " ") != NULL)
+  else if(strlen(options->serve_) < sizeof(address.sun_path))
   {
-    printf("Please enter the correct number of parameters!\n");
-    free(input);
-    return false;
+    // a socket left behind by an earlier server is replaced
+    strcpy(address.sun_path, options->serve_);
+    unlink(options->serve_);
+    server.listener_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    server.epoll_ = epoll_create1(0);
   }
-  if(*last_card)
+  else
   {
-    printf("Please enter a command you can use at the moment!\n");
-    free(input);
-    return false;
+    printf("Error: Cannot open file: %s\n", options->serve_);
   }
-  drawCommand(player, stack);
-  free(input);
-  return true;
-}
-
-int readAndDoAction(Player *player,Player *opponent, Card **latest_played, int *said_value, char *said_spice,
-                    bool *last_card, Card **stack, Card **discard, int *played)
-{
-  char *input;
-  while(true)
+  // SIGINT and SIGTERM are read from a descriptor in the event loop, so the server stops between events
+  sigset_t stop_signals;
+  sigset_t old_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  int stop = -1;
+  bool masked = server.listener_ >= 0 && sigprocmask(SIG_BLOCK, &stop_signals, &old_signals) == 0;
+  if(masked)
   {
-    printf("P%d > ", player->id_);
-    input = getInput();
-    if(input == NULL)
-    {
-      return OUT_OF_MEMORY;
-    }
-    char *token = strtok(input," ");
-    if(token == NULL || (strcmp(token, "quit") != 0 && strcmp(token, "play") != 0 &&
-                         strcmp(token, "challenge") != 0 && strcmp(token, "draw") != 0))
-    {
-      printf("Please enter a valid command!\n");
-      free(input);
-      continue;
-    }
-    if(strcmp(token, "quit") == 0)
-    {
-      if(checkQuit(input))
-      {
-        return QUIT;
-      }
-      else
-      {
-        continue;
-      }
-    }
-    if(strcmp(token, "play") == 0)
-    {
-      if(checkPlay(input, player, latest_played, said_value, said_spice, last_card, discard, played))
-      {
-        break;
-      }
-      else
-      {
-        continue;
-      }
-    }
-    if(strcmp(token, "challenge") == 0)
-    {
-      if(checkChallenge(input, player, opponent, latest_played, said_value, said_spice, last_card, discard, stack, played))
-      {
-        return CHALLENGE;
-      }
-      else
-      {
-        continue;
-      }
-    }
-    if(strcmp(token, "draw") == 0)
-    {
-      if(checkDraw(input, player, stack, last_card))
-      {
-        break;
-      }
-      else
-      {
-        continue;
-      }
-    }
+    stop = signalfd(-1, &stop_signals, SFD_NONBLOCK);
   }
-  return ALRIGHT;
-}
-
-int playingTheGame(Card **stack, Player *player_1, Player *player_2, Card **discard)
-{
-  Player *first = player_1;
-  first->draw_last_turn = false;
-  first->round_loser = false;
-  first->points_ = 0;
-  Player *second = player_2;
-  second->draw_last_turn = false;
-  second->round_loser = false;
-  second->points_ = 0;
-  Card *latest_played = NULL;
-  int said_value = 0;
-  char said_spice = 'a';
-  bool last_card = false;
-  int played = 0;
-  bool finished = false;
-  while(!finished)
+  struct epoll_event listen_event = {.events = EPOLLIN, .data.fd = server.listener_};
+  struct epoll_event stop_event = {.events = EPOLLIN, .data.fd = stop};
+  bool bound = server.listener_ >= 0 && server.epoll_ >= 0 && stop >= 0 &&
+               bind(server.listener_, (struct sockaddr *)&address, sizeof(address)) == 0;
+  int return_code = CANNOT_OPEN_FILE;
+  if(bound && listen(server.listener_, 128) == 0 && fcntl(server.listener_, F_SETFL, O_NONBLOCK) == 0 &&
+     epoll_ctl(server.epoll_, EPOLL_CTL_ADD, server.listener_, &listen_event) == 0 &&
+     epoll_ctl(server.epoll_, EPOLL_CTL_ADD, stop, &stop_event) == 0)
   {
-    printf("\n-------------------\nROUND START\n-------------------\n");
-    while(true)
+    printf("Serving %d tables of %d players on %s\n", server.table_count_, server.players_, options->serve_);
+    printRules(&deck->rules_);
+    fflush(stdout);
+    struct epoll_event events[SERVER_EVENTS];
+    bool running = true;
+    while(running)
     {
-      printPlayer(first, last_card, played,said_value, said_spice, latest_played);
-      int return_code = readAndDoAction(first, second, &latest_played, &said_value,
-                                        &said_spice, &last_card, stack, discard, &played);
-      if(return_code == QUIT || return_code == OUT_OF_MEMORY)
-      {
-        free(latest_played);
-        return return_code;
-      }
-      if(*stack == NULL)
-      {
-        finished = true;
-        break;
-      }
-      if(return_code == CHALLENGE)
-      {
-        break;
-      }
-      printPlayer(second,last_card, played, said_value, said_spice, latest_played);
-      return_code = readAndDoAction(second, first, &latest_played, &said_value,
-                                    &said_spice, &last_card, stack, discard, &played);
-      if(return_code == QUIT || return_code == OUT_OF_MEMORY)
-      {
-        free(latest_played);
-        return return_code;
-      }
-      if(*stack == NULL)
+      int count = epoll_wait(server.epoll_, events, SERVER_EVENTS, -1);
+      if(count < 0 && errno != EINTR)
       {
-        finished = true;
+        printf("Error: The server stopped: %s\n", strerror(errno));
         break;
       }
-      if(return_code == CHALLENGE)
+      for(int index = 0; index < count && running; index++)
       {
-        break;
+        if(events[index].data.fd == stop)
+        {
+          // reading the signal takes it off the pending ones, so restoring the mask later does not deliver it
+          struct signalfd_siginfo signal_info;
+          running = read(stop, &signal_info, sizeof(signal_info)) != (ssize_t)sizeof(signal_info);
+        }
+        else if(events[index].data.fd == server.listener_)
+        {
+          acceptClients(&server);
+        }
+        else
+        {
+          readClient(&server, events[index].data.fd);
+        }
       }
     }
-
-    if(second->round_loser)
+    if(!running)
     {
-      Player *temp = first;
-      first = second;
-      second = temp;
+      printf("Server stopped\n");
+      return_code = QUIT;
     }
-    first->round_loser = false;
-    second->round_loser = false;
-  }
-  free(latest_played);
-  return ALRIGHT;
-}
-
-void finishingTheGame(char **arg, Player *player_1, Player *player_2)
-{
-  if(player_1->points_ > player_2->points_)
-  {
-    printf("\nPlayer 1: %d points\n", player_1->points_);
-    printf("Player 2: %d points\n", player_2->points_);
-    printf("\nCongratulations! Player 1 wins the game!\n");
   }
-  else if(player_2->points_ > player_1->points_)
+  else if(server.listener_ >= 0)
   {
-    printf("\nPlayer 2: %d points\n", player_2->points_);
-    printf("Player 1: %d points\n", player_1->points_);
-    printf("\nCongratulations! Player 2 wins the game!\n");
+    printf("Error: Cannot open file: %s\n", options->serve_);
   }
-  else
+  if(stop >= 0)
   {
-    printf("\nPlayer 1: %d points\n", player_1->points_);
-    printf("Player 2: %d points\n", player_2->points_);
-    printf("\nCongratulations! Player 1 wins the game!\n");
-    printf("Congratulations! Player 2 wins the game!\n");
+    close(stop);
   }
-  FILE *file = fopen(arg[1],"a");
-  if(file == NULL)
+  if(masked)
   {
-    printf("Warning: Results not written to file!\n");
-    return;
+    sigprocmask(SIG_SETMASK, &old_signals, NULL);
   }
-  if(player_1->points_ > player_2->points_)
+  if(server.listener_ >= 0)
   {
-    fprintf(file, "\nPlayer 1: %d points\n", player_1->points_);
-    fprintf(file, "Player 2: %d points\n", player_2->points_);
-    fprintf(file, "\nCongratulations! Player 1 wins the game!\n");
+    close(server.listener_);
   }
-  else if(player_2->points_ > player_1->points_)
+  if(bound)
   {
-    fprintf(file, "\nPlayer 2: %d points\n", player_2->points_);
-    fprintf(file, "Player 1: %d points\n", player_1->points_);
-    fprintf(file, "\nCongratulations! Player 2 wins the game!\n");
+    unlink(options->serve_);
   }
-  else
+  if(server.epoll_ >= 0)
   {
-    fprintf(file, "\nPlayer 1: %d points\n", player_1->points_);
-    fprintf(file, "Player 2: %d points\n", player_2->points_);
-    fprintf(file, "\nCongratulations! Player 1 wins the game!\n");
-    fprintf(file, "Congratulations! Player 2 wins the game!\n");
+    close(server.epoll_);
   }
-  fclose(file);
-}
-
-void freeStack(Card **stack)
-{
-  Card *current = *stack;
-  while(current != NULL)
+  for(int table = 0; table < server.table_count_; table++)
   {
-    Card *temp = current;
-    current = current->next_;
-    free(temp);
+    free(server.tables_[table].game_);
   }
+  free(server.tables_);
+  free(server.clients_);
+  free(server.reply_);
+  return return_code;
 }